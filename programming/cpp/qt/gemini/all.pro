@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Builds the engine library, the headless runner, the benchmarks and the GUI
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += engine headless benchmark microbenchmark gemini
+
+engine.file = engine.pro
+headless.file = headless.pro
+headless.depends = engine
+benchmark.file = benchmark.pro
+benchmark.depends = engine
+microbenchmark.file = microbenchmark.pro
+microbenchmark.depends = engine
+gemini.file = gemini.pro
@@ -0,0 +1,263 @@
+/* KPCC
+ * Benchmark suite: runs reference patterns for a fixed number of
+ * generations and prints the speed and memory use as JSON, so that builds
+ * can be compared
+ * File: benchmark.cpp
+ */
+
+#include <algorithm>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "enginestats.h"
+#include "grid.h"
+#include "treenode.h"
+
+struct Workload
+{
+    QString name;
+    QString description;
+    QString file;            // pattern to load, if "build" is not set
+    void (*build)(Grid &grid);
+    long long generations;   // how far the pattern is run
+};
+
+// dense random soup, the same every time
+static void buildSoup(Grid &grid)
+{
+    qsrand(2016);
+    grid.clear();
+    grid.initRandom(256, 256);
+}
+
+// a large, highly repetitive pattern of the kind metacells are: 16 x 16
+// Gosper guns 128 cells apart, their streams crossing each other
+static void buildGunArray(Grid &grid)
+{
+    Grid gun;
+    gun.parseRLE(":/gosperglidergun.rle");
+    grid.clear();
+    for (int i = -8; i < 8; i++)
+    {
+        for (int j = -8; j < 8; j++)
+        {
+            grid.insertPattern(gun, i * 128, j * 128, true);
+        }
+    }
+}
+
+// peak resident set size of the process so far, in kilobytes;
+// -1 if unknown
+static long peakRssKb()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return -1;
+    }
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss / 1024; // bytes there
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+static bool buildWorkload(const Workload &workload, Grid &grid)
+{
+    if (workload.build != nullptr)
+    {
+        workload.build(grid);
+        return true;
+    }
+    if (!QFile::exists(workload.file))
+    {
+        return false;
+    }
+    if (workload.file.endsWith(".rle", Qt::CaseInsensitive))
+    {
+        return grid.parseRLE(workload.file);
+    }
+    if (workload.file.endsWith(".mc", Qt::CaseInsensitive))
+    {
+        return grid.parseMacrocell(workload.file);
+    }
+    if (workload.file.endsWith(".gsnap", Qt::CaseInsensitive))
+    {
+        return grid.parseSnapshot(workload.file);
+    }
+    return grid.parsePlainText(workload.file);
+}
+
+// runs the workload "repeat" times, each time with an empty hash
+static QJsonObject runWorkload(const Workload &workload, int repeat)
+{
+    QJsonObject result;
+    result["name"] = workload.name;
+    result["description"] = workload.description;
+    result["generations"] = (double)workload.generations;
+
+    QVector<double> times; // milliseconds
+    QJsonArray runs;
+    Grid grid;
+    long long nodesCreated = 0;
+    long long memoHits = 0;
+    long long memoMisses = 0;
+    double buildTime = 0;
+    for (int i = 0; i < repeat; i++)
+    {
+        TreeNode::clearHash();
+        grid = Grid();
+        QElapsedTimer clock;
+        clock.start();
+        if (!buildWorkload(workload, grid))
+        {
+            result["error"] = "could not load " + workload.file;
+            return result;
+        }
+        buildTime = clock.nsecsElapsed() / 1e6;
+
+        nodesCreated = EngineStats::getNodesCreated();
+        memoHits = EngineStats::get(EngineStats::MemoHits);
+        memoMisses = EngineStats::get(EngineStats::MemoMisses);
+        clock.start();
+        grid.advance(workload.generations);
+        double time = clock.nsecsElapsed() / 1e6;
+        nodesCreated = EngineStats::getNodesCreated() - nodesCreated;
+        memoHits = EngineStats::get(EngineStats::MemoHits) - memoHits;
+        memoMisses = EngineStats::get(EngineStats::MemoMisses) - memoMisses;
+
+        times.push_back(time);
+        runs.append(time);
+    }
+    sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+
+    result["buildMs"] = buildTime;
+    result["runsMs"] = runs;
+    result["minMs"] = times.first();
+    result["medianMs"] = median;
+    result["generationsPerSecond"] = median > 0 ?
+                                         workload.generations * 1e3 / median :
+                                         0;
+    result["population"] = (double)grid.getPopulation();
+    result["nodesCreated"] = (double)nodesCreated;
+    result["memoHits"] = (double)memoHits;
+    result["memoMisses"] = (double)memoMisses;
+    result["hashSize"] = grid.hashSize();
+    result["peakRssKb"] = (double)peakRssKb();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("gemini-benchmark");
+
+    QVector<Workload> workloads;
+    workloads.push_back({"gun", "Gosper glider gun, linear growth",
+                         ":/gosperglidergun.rle", nullptr, 4096});
+    workloads.push_back({"acorn", "methuselah, stabilizes at 5206",
+                         ":/acorn.rle", nullptr, 5206});
+    workloads.push_back({"rpentomino", "methuselah, stabilizes at 1103",
+                         ":/rpentomino.rle", nullptr, 1103});
+    workloads.push_back({"soup", "random 256x256 soup, half of the cells "
+                         "alive", "", buildSoup, 1024});
+    workloads.push_back({"gunarray", "16x16 Gosper guns, metacell-scale "
+                         "repetitive pattern", "", buildGunArray, 1024});
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs the reference workloads and prints "
+                                     "their speed and memory use as JSON. "
+                                     "Peak RSS is that of the whole process; "
+                                     "use --only to measure one workload.");
+    parser.addHelpOption();
+    QCommandLineOption repeatOption(QStringList() << "r" << "repeat",
+                                    "Run every workload <n> times.",
+                                    "n",
+                                    "3");
+    QCommandLineOption onlyOption(QStringList() << "only",
+                                  "Run only the workload <name> "
+                                  "(can be repeated).",
+                                  "name");
+    QCommandLineOption patternOption(QStringList() << "pattern",
+                                     "Also run <file> (.rle, .mc, .gsnap or "
+                                     "plain text) "
+                                     "for <n> generations, e.g. a breeder.",
+                                     "file:n");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "Write the results to <file>.",
+                                    "file");
+    parser.addOption(repeatOption);
+    parser.addOption(onlyOption);
+    parser.addOption(patternOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    foreach (const QString &pattern, parser.values(patternOption))
+    {
+        int colon = pattern.lastIndexOf(':');
+        bool ok = colon > 0;
+        long long generations = ok ? pattern.mid(colon + 1).toLongLong(&ok)
+                                   : 0;
+        if (!ok)
+        {
+            err << "Expected <file>:<generations>, got " << pattern << "\n";
+            return 1;
+        }
+        QString file = pattern.left(colon);
+        workloads.push_back({file, "user pattern", file, nullptr,
+                             generations});
+    }
+
+    int repeat = max(parser.value(repeatOption).toInt(), 1);
+    QStringList only = parser.values(onlyOption);
+
+    QJsonArray results;
+    foreach (const Workload &workload, workloads)
+    {
+        if (!only.isEmpty() && !only.contains(workload.name))
+        {
+            continue;
+        }
+        err << "Running " << workload.name << "...\n";
+        err.flush();
+        results.append(runWorkload(workload, repeat));
+    }
+
+    QJsonObject report;
+    report["qtVersion"] = QString(qVersion());
+    report["repeat"] = repeat;
+    report["workloads"] = results;
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            err << "Could not write " << file.fileName() << "\n";
+            return 1;
+        }
+        file.write(json);
+    }
+    else
+    {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Benchmark suite of reference patterns; links the static engine library
+# (build engine.pro first, or build all.pro)
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = gemini-benchmark
+TEMPLATE = app
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .obj/benchmark
+
+INCLUDEPATH += $$PWD
+
+LIBS += -L$$OUT_PWD -lgeminiengine
+PRE_TARGETDEPS += $$OUT_PWD/libgeminiengine.a
+
+SOURCES += benchmark.cpp
+
+RESOURCES += \
+    benchmark.qrc
@@ -0,0 +1,42 @@
+# Simulation engine: everything needed to load, run and save a field.
+# Shared by the GUI (gemini.pro) and the static library (engine.pro).
+# Drawing code is compiled only when QT contains gui.
+# CONFIG += gemini_no_stats compiles the engine counters out.
+
+INCLUDEPATH += $$PWD
+
+gemini_no_stats: DEFINES += GEMINI_NO_STATS
+
+SOURCES += \
+    $$PWD/grid.cpp \
+    $$PWD/treenode.cpp \
+    $$PWD/stepscheduler.cpp \
+    $$PWD/generationtask.cpp \
+    $$PWD/enginestats.cpp \
+    $$PWD/tracer.cpp \
+    $$PWD/treebuilder.cpp \
+    $$PWD/rlereader.cpp \
+    $$PWD/rlewriter.cpp \
+    $$PWD/plaintextreader.cpp \
+    $$PWD/snapshot.cpp \
+    $$PWD/nodepager.cpp \
+    $$PWD/fileprogress.cpp \
+    $$PWD/rasterizer.cpp \
+    $$PWD/viewport.cpp
+
+HEADERS += \
+    $$PWD/grid.h \
+    $$PWD/treenode.h \
+    $$PWD/stepscheduler.h \
+    $$PWD/generationtask.h \
+    $$PWD/enginestats.h \
+    $$PWD/tracer.h \
+    $$PWD/treebuilder.h \
+    $$PWD/rlereader.h \
+    $$PWD/rlewriter.h \
+    $$PWD/plaintextreader.h \
+    $$PWD/snapshot.h \
+    $$PWD/nodepager.h \
+    $$PWD/fileprogress.h \
+    $$PWD/rasterizer.h \
+    $$PWD/viewport.h
@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Static library with the simulation engine only:
+# no widgets, no OpenGL, no display needed
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = geminiengine
+TEMPLATE = lib
+
+CONFIG += c++11 staticlib
+
+# gemini.pro compiles the same sources with gui; keep the objects apart
+OBJECTS_DIR = .obj/engine
+
+include(engine.pri)
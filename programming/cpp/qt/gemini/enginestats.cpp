@@ -0,0 +1,143 @@
+/* KPCC
+ * EngineStats is the registry of counters kept by the engine
+ * File: enginestats.cpp
+ */
+
+#include <QJsonArray>
+
+#include "enginestats.h"
+#include "treenode.h"
+
+atomic<long long> EngineStats::counters[EngineStats::CounterCount];
+atomic<long long> EngineStats::created[EngineStats::maxLevel + 1];
+atomic<long long> EngineStats::alive[EngineStats::maxLevel + 1];
+
+long long EngineStats::get(Counter counter)
+{
+    return counters[counter].load(memory_order_relaxed);
+}
+
+long long EngineStats::getNodesCreated(int level)
+{
+    return created[level < maxLevel ? level : maxLevel]
+            .load(memory_order_relaxed);
+}
+
+long long EngineStats::getNodesAlive(int level)
+{
+    return alive[level < maxLevel ? level : maxLevel]
+            .load(memory_order_relaxed);
+}
+
+long long EngineStats::getNodesCreated()
+{
+    long long sum = 0;
+    for (int i = 0; i <= maxLevel; i++)
+    {
+        sum += getNodesCreated(i);
+    }
+    return sum;
+}
+
+long long EngineStats::getNodesAlive()
+{
+    long long sum = 0;
+    for (int i = 0; i <= maxLevel; i++)
+    {
+        sum += getNodesAlive(i);
+    }
+    return sum;
+}
+
+long long EngineStats::getBytesInUse()
+{
+    // make_shared puts a node and its reference counts into one block
+    return getNodesAlive() * (sizeof(TreeNode) + 2 * sizeof(long));
+}
+
+QString EngineStats::name(Counter counter)
+{
+    switch (counter)
+    {
+    case MemoHits:
+        return "memoHits";
+    case MemoMisses:
+        return "memoMisses";
+    case BaseCases:
+        return "baseCases";
+    case ExpandUniverse:
+        return "expandUniverse";
+    case Steps:
+        return "steps";
+    case StepNanoseconds:
+        return "stepNanoseconds";
+    case PageFaults:
+        return "pageFaults";
+    case PageEvictions:
+        return "pageEvictions";
+    case TileHits:
+        return "tileHits";
+    case TileMisses:
+        return "tileMisses";
+    case RepaintedPixels:
+        return "repaintedPixels";
+    case WidgetPixels:
+        return "widgetPixels";
+    default:
+        return "";
+    }
+}
+
+bool EngineStats::isEnabled()
+{
+#ifndef GEMINI_NO_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void EngineStats::reset()
+{
+    for (int i = 0; i < CounterCount; i++)
+    {
+        counters[i].store(0, memory_order_relaxed);
+    }
+    for (int i = 0; i <= maxLevel; i++)
+    {
+        created[i].store(0, memory_order_relaxed);
+    }
+}
+
+QJsonObject EngineStats::toJson()
+{
+    QJsonObject stats;
+    stats["enabled"] = isEnabled();
+    for (int i = 0; i < CounterCount; i++)
+    {
+        stats[name((Counter)i)] = (double)get((Counter)i);
+    }
+    long long lookups = get(MemoHits) + get(MemoMisses);
+    stats["memoHitRate"] = lookups > 0 ? (double)get(MemoHits) / lookups : 0;
+    stats["averageStepMs"] = get(Steps) > 0 ?
+                                 get(StepNanoseconds) / 1e6 / get(Steps) : 0;
+    stats["nodesCreated"] = (double)getNodesCreated();
+    stats["nodesAlive"] = (double)getNodesAlive();
+    stats["bytesInUse"] = (double)getBytesInUse();
+    stats["hashSize"] = TreeNode::hashSize();
+    QJsonArray levels;
+    for (int i = 0; i <= maxLevel; i++)
+    {
+        if (getNodesCreated(i) == 0 && getNodesAlive(i) == 0)
+        {
+            continue;
+        }
+        QJsonObject level;
+        level["level"] = i;
+        level["created"] = (double)getNodesCreated(i);
+        level["alive"] = (double)getNodesAlive(i);
+        levels.append(level);
+    }
+    stats["levels"] = levels;
+    return stats;
+}
@@ -0,0 +1,103 @@
+/* KPCC
+ * EngineStats is the registry of counters kept by the engine: memo hits
+ * and misses, nodes created and alive per level, base cases, steps and
+ * their time. Counting is cheap (relaxed atomic additions); building with
+ * GEMINI_NO_STATS defined compiles it out, and then all counters read 0
+ * File: enginestats.h
+ */
+
+#ifndef ENGINESTATS_H
+#define ENGINESTATS_H
+
+#include <atomic>
+#include <QJsonObject>
+#include <QString>
+
+using namespace std;
+
+class EngineStats
+{
+public:
+    enum Counter
+    {
+        MemoHits,        // nextGeneration found its result in the hash
+        MemoMisses,      // nextGeneration had to compute its result
+        BaseCases,       // 4x4 nodes advanced by slowSimulation
+        ExpandUniverse,  // calls of TreeNode::expandUniverse
+        Steps,           // steps finished by Grid
+        StepNanoseconds, // time spent computing them
+        PageFaults,      // paged nodes whose children were read
+        PageEvictions,   // paged nodes whose children were dropped
+        TileHits,        // nodes drawn from a tile of the Rasterizer
+        TileMisses,      // tiles the Rasterizer had to draw
+        RepaintedPixels, // pixels of the field the widget painted again
+        WidgetPixels,    // pixels it would have painted repainting whole
+        CounterCount
+    };
+
+    // nodes of higher levels are counted as nodes of this one
+    static const int maxLevel = 63;
+
+    static void add(Counter counter, long long n = 1);
+    static void nodeCreated(int level);
+    static void nodeDestroyed(int level);
+
+    static long long get(Counter counter);
+    static long long getNodesCreated(int level);
+    static long long getNodesAlive(int level);
+    // sums over all the levels
+    static long long getNodesCreated();
+    static long long getNodesAlive();
+    // approximate memory taken by the living nodes, without the hash
+    static long long getBytesInUse();
+
+    // the name of a counter as it is written to JSON
+    static QString name(Counter counter);
+
+    // false if built with GEMINI_NO_STATS
+    static bool isEnabled();
+
+    // sets all the counters to 0, except the numbers of living nodes
+    static void reset();
+
+    // all the counters, and the nodes of every level that has any
+    static QJsonObject toJson();
+
+private:
+    static atomic<long long> counters[CounterCount];
+    static atomic<long long> created[maxLevel + 1];
+    static atomic<long long> alive[maxLevel + 1];
+};
+
+inline void EngineStats::add(Counter counter, long long n)
+{
+#ifndef GEMINI_NO_STATS
+    counters[counter].fetch_add(n, memory_order_relaxed);
+#else
+    (void)counter;
+    (void)n;
+#endif
+}
+
+inline void EngineStats::nodeCreated(int level)
+{
+#ifndef GEMINI_NO_STATS
+    level = level < maxLevel ? level : maxLevel;
+    created[level].fetch_add(1, memory_order_relaxed);
+    alive[level].fetch_add(1, memory_order_relaxed);
+#else
+    (void)level;
+#endif
+}
+
+inline void EngineStats::nodeDestroyed(int level)
+{
+#ifndef GEMINI_NO_STATS
+    level = level < maxLevel ? level : maxLevel;
+    alive[level].fetch_sub(1, memory_order_relaxed);
+#else
+    (void)level;
+#endif
+}
+
+#endif // ENGINESTATS_H
@@ -0,0 +1,46 @@
+/* KPCC
+ * FileProgress is shared between a file being read or written and the
+ * window showing how far it has got
+ * File: fileprogress.cpp
+ */
+
+#include "fileprogress.h"
+
+FileProgress::FileProgress()
+{
+    reset();
+}
+
+void FileProgress::reset()
+{
+    done = 0;
+    total = 0;
+    cancelled = false;
+}
+
+bool FileProgress::report(qint64 done, qint64 total)
+{
+    this->done = done;
+    this->total = total;
+    return !cancelled;
+}
+
+double FileProgress::fraction() const
+{
+    qint64 t = total;
+    if (t <= 0)
+    {
+        return -1;
+    }
+    return qMin((double)done / t, 1.0);
+}
+
+void FileProgress::cancel()
+{
+    cancelled = true;
+}
+
+bool FileProgress::isCancelled() const
+{
+    return cancelled;
+}
@@ -0,0 +1,41 @@
+/* KPCC
+ * FileProgress is shared between a file being read or written on one
+ * thread and the window showing how far it has got on another, which can
+ * also ask it to stop. Readers and writers report now and then (about
+ * every megabyte or every few thousand nodes), so checking is cheap
+ * File: fileprogress.h
+ */
+
+#ifndef FILEPROGRESS_H
+#define FILEPROGRESS_H
+
+#include <atomic>
+#include <QtGlobal>
+
+using namespace std;
+
+class FileProgress
+{
+private:
+    atomic<qint64> done;
+    atomic<qint64> total;   // 0 if not known
+    atomic<bool> cancelled;
+
+public:
+    FileProgress();
+
+    // starts again: nothing done, not cancelled
+    void reset();
+
+    // "done" of "total" (any units, total 0 if not known); returns false
+    // if the work should stop
+    bool report(qint64 done, qint64 total);
+
+    // from 0 to 1, or -1 if the total is not known
+    double fraction() const;
+
+    void cancel();
+    bool isCancelled() const;
+};
+
+#endif // FILEPROGRESS_H
@@ -8,23 +8,28 @@ QT       += core gui
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
+# files are read and written on another thread
+QT += concurrent
+
 TARGET = gemini
 TEMPLATE = app
 
 CONFIG += c++11
 
+OBJECTS_DIR = .obj/gemini
+
+include(engine.pri)
+
 SOURCES += main.cpp\
         userinterface.cpp \
-    grid.cpp \
     gridpainter.cpp \
     propertieswindow.cpp \
-    treenode.cpp
+    minimap.cpp
 
 HEADERS  += userinterface.h \
-    grid.h \
     gridpainter.h \
-    treenode.h \
-    propertieswindow.h
+    propertieswindow.h \
+    minimap.h
 
 RESOURCES += \
     treemodel.qrc
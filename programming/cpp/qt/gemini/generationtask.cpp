@@ -0,0 +1,206 @@
+/* KPCC
+ * GenerationTask computes TreeNode::nextGeneration with an explicit stack
+ * instead of recursion, so that the computation can be suspended after a
+ * given time, resumed later or cancelled
+ * File: generationtask.cpp
+ */
+
+#include <QElapsedTimer>
+
+#include "enginestats.h"
+#include "generationtask.h"
+
+GenerationTask::GenerationTask()
+{
+}
+
+void GenerationTask::start(shared_ptr<TreeNode> node, int stepLog2)
+{
+    stack.clear();
+    answer = nullptr;
+    push(node, stepLog2);
+}
+
+void GenerationTask::push(shared_ptr<TreeNode> node, int step)
+{
+    Frame frame;
+    frame.node = node;
+    frame.step = step;
+    frame.phase = 0;
+    frame.next = 0;
+    stack.push_back(frame);
+}
+
+void GenerationTask::finish(shared_ptr<TreeNode> result)
+{
+    stack.pop_back();
+    if (stack.isEmpty())
+    {
+        answer = result;
+        return;
+    }
+    Frame &parent = stack.last();
+    if (parent.phase == 1)
+    {
+        parent.sub[parent.next++] = result;
+    }
+    else
+    {
+        parent.quad[parent.next++] = result;
+    }
+}
+
+/**
+*   The same algorithm as the recursive one described in treenode.h: nine
+*   subnodes a quarter of the node in size are built, combined in groups of
+*   four, and the four combined nodes are advanced and joined into the
+*   result. If the step is as big as the node allows, the nine subnodes are
+*   advanced by the first half of the step themselves (phase 1), and the
+*   four combined nodes - by the second half (phase 2); otherwise only
+*   phase 2 is needed.
+*/
+bool GenerationTask::run(qint64 nanoseconds)
+{
+    QElapsedTimer clock;
+    clock.start();
+    int iterations = 0;
+    while (!stack.isEmpty())
+    {
+        // looking at the clock is not free, so we do it now and then
+        if (nanoseconds >= 0 && ++iterations % 256 == 0 &&
+            clock.nsecsElapsed() > nanoseconds)
+        {
+            return false;
+        }
+        Frame &f = stack.last();
+        shared_ptr<TreeNode> n = f.node;
+        if (f.phase == 0)
+        {
+            f.step = min(f.step, n->level - 2);
+            shared_ptr<TreeNode> result = TreeNode::hashMap[f.step].value(n,
+                                                                    nullptr);
+            if (result != nullptr)
+            {
+                EngineStats::add(EngineStats::MemoHits);
+                finish(result);
+                continue;
+            }
+            // skip empty regions quickly
+            if (n->population == 0)
+            {
+                finish(n->nw());
+                continue;
+            }
+            EngineStats::add(EngineStats::MemoMisses);
+            if (n->level == 2)
+            {
+                finish(TreeNode::hashMap[0][n] = n->slowSimulation());
+                continue;
+            }
+            if (f.step == n->level - 2)
+            {
+                f.sub[0] = n->nw();
+                f.sub[1] = make_shared<TreeNode>(n->nw()->ne(), n->ne()->nw(),
+                                                 n->nw()->se(), n->ne()->sw());
+                f.sub[2] = n->ne();
+                f.sub[3] = make_shared<TreeNode>(n->nw()->sw(), n->nw()->se(),
+                                                 n->sw()->nw(), n->sw()->ne());
+                f.sub[4] = make_shared<TreeNode>(n->nw()->se(), n->ne()->sw(),
+                                                 n->sw()->ne(), n->se()->nw());
+                f.sub[5] = make_shared<TreeNode>(n->ne()->sw(), n->ne()->se(),
+                                                 n->se()->nw(), n->se()->ne());
+                f.sub[6] = n->sw();
+                f.sub[7] = make_shared<TreeNode>(n->sw()->ne(), n->se()->nw(),
+                                                 n->sw()->se(), n->se()->sw());
+                f.sub[8] = n->se();
+                f.phase = 1;
+                f.next = 0;
+                continue;
+            }
+            f.sub[0] = n->nw()->centeredSubnode();
+            f.sub[1] = n->centeredHorizontal(n->nw(), n->ne());
+            f.sub[2] = n->ne()->centeredSubnode();
+            f.sub[3] = n->centeredVertical(n->nw(), n->sw());
+            f.sub[4] = n->centeredSubSubnode();
+            f.sub[5] = n->centeredVertical(n->ne(), n->se());
+            f.sub[6] = n->sw()->centeredSubnode();
+            f.sub[7] = n->centeredHorizontal(n->sw(), n->se());
+            f.sub[8] = n->se()->centeredSubnode();
+            f.phase = 1;
+            f.next = 9;
+        }
+        if (f.phase == 1)
+        {
+            if (f.next < 9)
+            {
+                push(f.sub[f.next], f.step);
+                continue;
+            }
+            f.quad[0] = make_shared<TreeNode>(f.sub[0], f.sub[1],
+                                              f.sub[3], f.sub[4]);
+            f.quad[1] = make_shared<TreeNode>(f.sub[1], f.sub[2],
+                                              f.sub[4], f.sub[5]);
+            f.quad[2] = make_shared<TreeNode>(f.sub[3], f.sub[4],
+                                              f.sub[6], f.sub[7]);
+            f.quad[3] = make_shared<TreeNode>(f.sub[4], f.sub[5],
+                                              f.sub[7], f.sub[8]);
+            f.phase = 2;
+            f.next = 0;
+        }
+        if (f.next < 4)
+        {
+            push(f.quad[f.next], f.step);
+            continue;
+        }
+        finish(TreeNode::hashMap[f.step][n] = make_shared<TreeNode>(f.quad[0],
+                                                                   f.quad[1],
+                                                                   f.quad[2],
+                                                                   f.quad[3]));
+    }
+    return true;
+}
+
+void GenerationTask::cancel()
+{
+    stack.clear();
+    answer = nullptr;
+}
+
+bool GenerationTask::isRunning() const
+{
+    return !stack.isEmpty();
+}
+
+double GenerationTask::progress() const
+{
+    if (!isRunning())
+    {
+        return answer != nullptr ? 1 : 0;
+    }
+    // every frame has 13 parts of equal weight: nine subnodes and four
+    // combined nodes; a part that is being computed is counted by the
+    // frames above it
+    double done = 0;
+    double weight = 1;
+    for (int i = 0; i < stack.size(); i++)
+    {
+        const Frame &f = stack[i];
+        int parts = 0;
+        if (f.phase == 1)
+        {
+            parts = f.next;
+        }
+        if (f.phase == 2)
+        {
+            parts = 9 + f.next;
+        }
+        done += weight * parts / 13;
+        weight /= 13;
+    }
+    return done;
+}
+
+shared_ptr<TreeNode> GenerationTask::result() const
+{
+    return answer;
+}
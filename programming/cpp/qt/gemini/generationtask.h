@@ -0,0 +1,69 @@
+/* KPCC
+ * GenerationTask computes TreeNode::nextGeneration with an explicit stack
+ * instead of recursion, so that the computation can be suspended after a
+ * given time, resumed later or cancelled
+ * File: generationtask.h
+ */
+
+#ifndef GENERATIONTASK_H
+#define GENERATIONTASK_H
+
+#include <memory>
+#include <QVector>
+
+#include "treenode.h"
+
+using namespace std;
+
+class GenerationTask
+{
+private:
+    // one call of nextGeneration that has not returned yet
+    struct Frame
+    {
+        shared_ptr<TreeNode> node; // node being advanced
+        int step;                  // it is advanced by 2^step generations
+        int phase;                 // 0 - not started yet;
+                                   // 1 - advancing the nine subnodes;
+                                   // 2 - advancing the four combined nodes
+        int next;                  // subnode whose result is awaited
+        shared_ptr<TreeNode> sub[9];  // nine subnodes; in phase 1 they are
+                                      // replaced by their results
+        shared_ptr<TreeNode> quad[4]; // four combined nodes; in phase 2
+                                      // they are replaced by their results
+    };
+
+    QVector<Frame> stack;
+    shared_ptr<TreeNode> answer;
+
+    void push(shared_ptr<TreeNode> node, int step);
+
+    // pops the top frame and gives its result to the frame below
+    void finish(shared_ptr<TreeNode> result);
+
+public:
+    GenerationTask();
+
+    // starts advancing "node" by 2^stepLog2 generations; nothing is
+    // computed until run is called
+    void start(shared_ptr<TreeNode> node, int stepLog2);
+
+    // computes for about "nanoseconds" (or until done, if it is negative)
+    // returns true if the result is ready
+    bool run(qint64 nanoseconds);
+
+    // abandons the computation; the subresults found so far stay in the
+    // hash, so starting it again will be quicker
+    void cancel();
+
+    // true if started, but neither finished nor cancelled
+    bool isRunning() const;
+
+    // estimated part of the work done, from 0 to 1
+    double progress() const;
+
+    // the advanced node, once run returned true
+    shared_ptr<TreeNode> result() const;
+};
+
+#endif // GENERATIONTASK_H
@@ -9,12 +9,27 @@
 #include <limits>
 #include <math.h>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
 
+#include "enginestats.h"
 #include "grid.h"
+#include "nodepager.h"
+#include "plaintextreader.h"
+#include "rlereader.h"
+#include "rlewriter.h"
+#include "snapshot.h"
+#include "tracer.h"
+#include "treebuilder.h"
 
 Grid::Grid()
 {
+    taskStepLog2 = 0;
+    atLimit = false;
     initEmptyGrid(80, 25);
 }
 
@@ -22,7 +37,9 @@ void Grid::initEmptyGrid(int width, int height)
 {
     int maxDimension = width > height ? width : height;
     int i = ceil(log2(maxDimension));
+    cancelStep();
     root = root->emptyTree(i);
+    pager = nullptr;
     generationCount = 0;
 }
 
@@ -41,176 +58,380 @@ void Grid::initRandom(int width, int height)
     generationCount = 0;
 }
 
-bool Grid::parsePlainText(const QString &fileName)
+bool Grid::parsePlainText(const QString &fileName, FileProgress *progress)
 {
-    QFile file(fileName);
-    file.open(QIODevice::ReadOnly | QIODevice::Text);
-    QTextStream fin(&file);
-    this->clear();
-
-    bool success = true;
-
-    QString currentString;
-    do
+    TRACE_ZONE("Grid::parsePlainText");
+    TreeBuilder builder;
+    PlainTextReader reader(builder, progress);
+    if (!reader.read(fileName))
     {
-        currentString = fin.readLine();
+        return false;
     }
-    while (currentString[0] == '!');
-
-    QString lineOfBody = currentString; // that is, the first row of cells
-
-    QVector<QString> body;
-
-    body.push_back(lineOfBody);
-    int maxWidth = lineOfBody.length(); // width of a pattern
-
-    while (!fin.atEnd())
+    shared_ptr<TreeNode> pattern = reader.getTree();
+    if (pattern->getLevel() > maxLevel)
     {
-        lineOfBody = fin.readLine();
-        body.push_back(lineOfBody);
-        if (maxWidth < lineOfBody.length())
-        {
-            maxWidth = lineOfBody.length();
-        }
-        if (maxWidth > 3000) // too big pattern; probably an error
-        {
-            success = false;
-            break;
-        }
-        if (body.length() > 3000) // too big pattern; probably an error
-        {
-            success = false;
-            break;
-        }
+        return false;
     }
+    cancelStep();
+    root = pattern;
+    pager = nullptr;
+    generationCount = 0;
+    return true;
+}
 
-    file.close();
-
-    if (!success)
+bool Grid::parseRLE(const QString &fileName, FileProgress *progress)
+{
+    TRACE_ZONE("Grid::parseRLE");
+    TreeBuilder builder;
+    RleReader reader(builder, progress);
+    if (!reader.read(fileName))
     {
         return false;
     }
-
-    for (int i = 0; i < body.size(); i++)
+    shared_ptr<TreeNode> pattern = builder.finish(reader.getLevel());
+    if (pattern->getLevel() > maxLevel)
     {
-        for (int j = 0; j < body[i].length(); j++)
-        {
-            if (body[i][j] != '.')
-            {
-                this->setAlive(i - body.size() / 2, j - maxWidth / 2, true);
-            }
-        }
+        return false;
     }
+    cancelStep();
+    root = pattern;
+    pager = nullptr;
+    generationCount = 0;
+    return true;
+}
 
-    return success; // that is, true
+// a node of "size" x "size" cells from cells[y..][x..]
+static shared_ptr<TreeNode> buildMacrocellLeaf(bool cells[8][8],
+                                              int x,
+                                              int y,
+                                              int size,
+                                              shared_ptr<TreeNode> alive,
+                                              shared_ptr<TreeNode> dead)
+{
+    if (size == 1)
+    {
+        return cells[y][x] ? alive : dead;
+    }
+    int half = size / 2;
+    return make_shared<TreeNode>(
+                buildMacrocellLeaf(cells, x, y, half, alive, dead),
+                buildMacrocellLeaf(cells, x + half, y, half, alive, dead),
+                buildMacrocellLeaf(cells, x, y + half, half, alive, dead),
+                buildMacrocellLeaf(cells, x + half, y + half, half,
+                                   alive, dead));
 }
 
-bool Grid::parseRLE(const QString &fileName)
+bool Grid::parseMacrocell(const QString &fileName, FileProgress *progress)
 {
+    TRACE_ZONE("Grid::parseMacrocell");
     QFile file(fileName);
-    file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        return false;
+    }
     QTextStream fin(&file);
-    this->clear();
-    this->initEmptyGrid(5, 5);
-    QString inputLine;
-    int x = 0, y = 0;      // current location
-    int paramArgument = 0; // our parameter location
+    if (!fin.readLine().startsWith("[M2]"))
+    {
+        return false;
+    }
 
-    bool success = true;
+    // nodes[i] is the node of the i-th node line; 0 means an empty node
+    QVector<shared_ptr<TreeNode> > nodes;
+    nodes.push_back(nullptr);
+    QVector<shared_ptr<TreeNode> > emptyNodes; // of every level
+    emptyNodes.push_back(make_shared<TreeNode>(false));
+    shared_ptr<TreeNode> alive = make_shared<TreeNode>(true);
+    long long generation = 0;
     while (!fin.atEnd())
     {
-        inputLine = fin.readLine();
-        if (inputLine.length() != 0 && (inputLine[0] == 'x'
-                                       || inputLine[0] == '#'))
+        // the position is that of the buffer, which is near enough
+        if (progress != nullptr && nodes.size() % 4096 == 0 &&
+            !progress->report(file.pos(), file.size()))
+        {
+            return false;
+        }
+        QString line = fin.readLine().trimmed();
+        if (line.isEmpty())
         {
-            continue; // We do not care of comment lines
+            continue;
         }
-        for (int i = 0; i < inputLine.length(); i++)
+        if (line[0] == '#')
         {
-            QChar c = inputLine[i];
-            int param = (paramArgument == 0 ? 1 : paramArgument);
-            if (c == 'b')
+            bool ok = true;
+            if (line.startsWith("#G"))
             {
-                x += param;
-                paramArgument = 0;
+                generation = line.mid(2).trimmed().toLongLong(&ok);
             }
-            else
+            if (line.startsWith("#R"))
             {
-                if (c == 'o')
+                QString rule = line.mid(2).trimmed().toUpper();
+                ok = rule == "B3/S23" || rule == "23/3";
+            }
+            if (!ok)
+            {
+                return false;
+            }
+            continue;
+        }
+        if (!line[0].isDigit())
+        {
+            // 8x8 leaf: '*' - alive, '.' - dead, '$' ends a row
+            bool cells[8][8] = {};
+            int x = 0;
+            int y = 0;
+            for (int i = 0; i < line.length(); i++)
+            {
+                if (line[i] == '$')
                 {
-                    while (param-- > 0)
-                    {
-                        this->setAlive(x++, y, true);
-                    }
-                    paramArgument = 0;
+                    x = 0;
+                    y++;
+                    continue;
                 }
-                else
+                if ((line[i] != '.' && line[i] != '*') || x >= 8 || y >= 8)
                 {
-                    if (c == '$')
-                    {
-                        y += param;
-                        x = 0;
-                        paramArgument = 0;
-                    }
-                    else
-                    {
-                        if ('0' <= c && c <= '9')
-                        {
-                            paramArgument = 10 * paramArgument + c.digitValue();
-                        }
-                        else
-                        {
-                            if (c == '!')
-                            {
-                                success = true;
-                                break;
-                            }
-                            else
-                            {
-                                if (c == ' ')
-                                {
-                                    continue;
-                                }
-                                else
-                                {
-                                    success = false;
-                                    break;
-                                }
-                            }
-                        }
-                    }
+                    return false;
                 }
+                cells[y][x++] = line[i] == '*';
+            }
+            nodes.push_back(buildMacrocellLeaf(cells, 0, 0, 8,
+                                               alive, emptyNodes[0]));
+            continue;
+        }
+        // "level nw ne sw se", the children being numbers of earlier lines
+        QStringList parts = line.split(' ', QString::SkipEmptyParts);
+        bool ok = parts.size() == 5;
+        int level = ok ? parts[0].toInt(&ok) : 0;
+        if (!ok || level < 4 || level > maxLevel)
+        {
+            return false;
+        }
+        while (emptyNodes.size() < level)
+        {
+            shared_ptr<TreeNode> e = emptyNodes.last();
+            emptyNodes.push_back(make_shared<TreeNode>(e, e, e, e));
+        }
+        shared_ptr<TreeNode> children[4];
+        for (int i = 0; i < 4; i++)
+        {
+            int index = parts[i + 1].toInt(&ok);
+            if (!ok || index < 0 || index >= nodes.size())
+            {
+                return false;
+            }
+            children[i] = index == 0 ? emptyNodes[level - 1] : nodes[index];
+            if (children[i]->getLevel() != level - 1)
+            {
+                return false;
             }
         }
+        nodes.push_back(make_shared<TreeNode>(children[0], children[1],
+                                              children[2], children[3]));
+    }
+    if (nodes.size() < 2)
+    {
+        return false;
+    }
+    // the centre of the last node, the root, is (0, 0)
+    cancelStep();
+    root = nodes.last();
+    pager = nullptr;
+    generationCount = generation;
+    return true;
+}
+
+// writes "node" and the nodes under it that were not written yet, and
+// returns its number; numbers go in the order of writing, from 1. Returns
+// -1 if writing was cancelled
+static int writeMacrocellNode(QTextStream &stream,
+                              shared_ptr<TreeNode> node,
+                              QHash<shared_ptr<TreeNode>, int> &numbers,
+                              FileProgress *progress)
+{
+    if (node->getPopulation() == 0)
+    {
+        return 0;
+    }
+    int number = numbers.value(node, 0);
+    if (number != 0)
+    {
+        return number;
+    }
+    if (node->getLevel() == 3)
+    {
+        QString leaf;
+        for (int y = -4; y < 4; y++)
+        {
+            QString row;
+            for (int x = -4; x < 4; x++)
+            {
+                row += node->getBit(x, y) == 1 ? '*' : '.';
+            }
+            while (row.endsWith('.'))
+            {
+                row.chop(1);
+            }
+            leaf += row + '$';
+        }
+        // empty rows at the end are not written
+        while (leaf.endsWith("$$"))
+        {
+            leaf.chop(1);
+        }
+        stream << leaf << "\n";
+    }
+    else
+    {
+        int nw = writeMacrocellNode(stream, node->getnw(), numbers, progress);
+        int ne = writeMacrocellNode(stream, node->getne(), numbers, progress);
+        int sw = writeMacrocellNode(stream, node->getsw(), numbers, progress);
+        int se = writeMacrocellNode(stream, node->getse(), numbers, progress);
+        if (nw < 0 || ne < 0 || sw < 0 || se < 0)
+        {
+            return -1;
+        }
+        stream << node->getLevel() << " " << nw << " " << ne << " "
+               << sw << " " << se << "\n";
+    }
+    number = numbers.size() + 1;
+    numbers[node] = number;
+    // the number of nodes is not known until they are written
+    if (progress != nullptr && number % 4096 == 0 &&
+        !progress->report(number, 0))
+    {
+        return -1;
+    }
+    return number;
+}
+
+bool Grid::saveAsMacrocell(const QString &fileName,
+                           FileProgress *progress) const
+{
+    TRACE_ZONE("Grid::saveAsMacrocell");
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                   QIODevice::Text))
+    {
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << "[M2] (Gemini)\n";
+    stream << "#R B3/S23\n";
+    if (generationCount != 0)
+    {
+        stream << "#G " << generationCount << "\n";
+    }
+    shared_ptr<TreeNode> node = root;
+    while (node->getLevel() < 3)
+    {
+        node = node->expandUniverse();
+    }
+    if (node->getPopulation() == 0)
+    {
+        // an empty leaf, so that there is a root
+        stream << "$\n";
+    }
+    else
+    {
+        // identical subtrees are equal keys, so each is written once
+        QHash<shared_ptr<TreeNode>, int> numbers;
+        if (writeMacrocellNode(stream, node, numbers, progress) < 0)
+        {
+            return false;
+        }
+    }
+    stream.flush();
+    return stream.status() == QTextStream::Ok && file.commit();
+}
+
+bool Grid::parseSnapshot(const QString &fileName, FileProgress *progress)
+{
+    TRACE_ZONE("Grid::parseSnapshot");
+    shared_ptr<TreeNode> node;
+    long long generation;
+    int stepLog2;
+    if (!Snapshot::load(fileName, node, generation, stepLog2, progress) ||
+        node->getLevel() > maxLevel)
+    {
+        return false;
+    }
+    cancelStep();
+    root = node;
+    pager = nullptr;
+    generationCount = generation;
+    if (stepLog2 >= 0)
+    {
+        beginStep(stepLog2);
+    }
+    return true;
+}
+
+bool Grid::openPaged(const QString &fileName)
+{
+    TRACE_ZONE("Grid::openPaged");
+    shared_ptr<NodePager> file = NodePager::open(fileName);
+    if (file == nullptr || file->root()->getLevel() > maxLevel)
+    {
+        return false;
+    }
+    cancelStep();
+    if (pager != nullptr)
+    {
+        file->setBudget(pager->getBudget());
     }
-    // move the pattern to the centre
-    if (!root->getnw()->isAlive() &&
-        !root->getne()->isAlive() &&
-        !root->getsw()->isAlive() &&
-        success)
+    pager = file;
+    root = pager->root();
+    generationCount = pager->getGeneration();
+    if (pager->getStepLog2() >= 0)
     {
-        root = root->getse();
+        beginStep(pager->getStepLog2());
     }
-    file.close();
-    return success;
+    return true;
+}
+
+bool Grid::isPaged() const
+{
+    return pager != nullptr;
 }
 
-void Grid::saveAsPlainText(const QString &fileName)
+void Grid::setPageBudget(int nodes)
 {
+    if (pager != nullptr)
+    {
+        pager->setBudget(nodes);
+        pager->trim();
+    }
+}
+
+bool Grid::saveAsSnapshot(const QString &fileName,
+                          FileProgress *progress) const
+{
+    TRACE_ZONE("Grid::saveAsSnapshot");
+    return Snapshot::save(fileName, root, generationCount,
+                          isStepping() ? taskStepLog2 : -1, progress);
+}
+
+bool Grid::saveAsPlainText(const QString &fileName,
+                           FileProgress *progress) const
+{
+    TRACE_ZONE("Grid::saveAsPlainText");
     QVector<QVector<int> > cells = as2dArray();
     if (cells.size() == 0)
     {
-        return;
+        return true; // nothing to write
     }
-    QFile file(fileName);
-    if (!file.open(QFile::ReadWrite | QFile::Truncate | QFile::Text))
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
     {
-        return;
+        return false;
     }
     QTextStream stream(&file);
     stream << "!Created in Gemini\n";
     for (int i = 0; i < cells.size(); ++i)
     {
+        if (progress != nullptr && !progress->report(i, cells.size()))
+        {
+            return false;
+        }
         for (int j = 0; j < cells[i].size(); ++j)
         {
             if (cells[i][j] == 0)
@@ -224,76 +445,40 @@ void Grid::saveAsPlainText(const QString &fileName)
         }
         stream << "\n";
     }
+    stream.flush();
+    return stream.status() == QTextStream::Ok && file.commit();
 }
 
-void Grid::saveAsRLE(const QString &fileName)
+bool Grid::saveAsRLE(const QString &fileName, FileProgress *progress) const
 {
-    QVector<QVector<int> > cells = as2dArray();
-    if (cells.size() == 0)
+    TRACE_ZONE("Grid::saveAsRLE");
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                   QIODevice::Text))
     {
-        return;
-    }
-    QFile file(fileName);
-    if (!file.open(QFile::ReadWrite | QFile::Truncate | QFile::Text))
-    {
-        return;
+        return false;
     }
     QTextStream stream(&file);
     stream << "#C Created in Gemini\n";
-    int width = cells[0].size();
-    int height = cells.size();
-    stream << "x = " << width << ",y = " << height
-           << "rule = b3/s23\n";
-    int run = 1; // number of identical cells going successively
-    for (int i = 0; i < width; ++i)
-    {
-        run = 1;
-        for (int j = 0; j < height - 1; ++j)
-        {
-            if (cells[j][i] == cells[j + 1][i])
-            {
-                ++run;
-            }
-            else
-            {
-                if (run != 1)
-                {
-                    stream << run;
-                }
-                if (cells[j][i] == 1)
-                {
-                    stream << "o";
-                }
-                else
-                {
-                    stream << "b";
-                }
-                run = 1;
-            }
-        }
-        if (cells[height - 1][i] != 0)
-        {
-            if (run != 1)
-            {
-                stream << run;
-            }
-            stream << "o";
-            // if dead cells are trailing at the end, we don't need to write
-        }
-        stream << "$";
+    if (!RleWriter(stream, progress).write(root))
+    {
+        return false;
     }
-    stream << "!";
+    stream.flush();
+    return stream.status() == QTextStream::Ok && file.commit();
 }
 
 void Grid::clear()
 {
+    cancelStep();
     root = root->emptyTree(root->getLevel());
+    pager = nullptr;
     generationCount = 0;
 }
 
 bool Grid::isEmpty() const
 {
-    return root->isAlive();
+    return !root->isAlive();
 }
 
 bool Grid::isAlive(int heightIndex, int widthIndex) const
@@ -303,8 +488,17 @@ bool Grid::isAlive(int heightIndex, int widthIndex) const
 
 void Grid::setAlive(int heightIndex, int widthIndex, bool isAlive)
 {
+    cancelStep();
+    int half = 1 << (maxLevel - 1);
+    if (widthIndex < -half || widthIndex >= half ||
+        heightIndex < -half || heightIndex >= half)
+    {
+        return;
+    }
     // If an index does not fit into grid
-    while (abs(widthIndex) > getWidth() / 2 || abs(heightIndex) > getHeight() /2)
+    // (-getWidth() / 2 <= index < getWidth() / 2)
+    while (widthIndex < -getWidth() / 2 || widthIndex >= getWidth() / 2 ||
+           heightIndex < -getHeight() / 2 || heightIndex >= getHeight() / 2)
     {
         root = root->expandUniverse();
     }
@@ -328,48 +522,208 @@ int Grid::getHeight() const
     return 1 << root->getLevel();
 }
 
+bool Grid::update()
+{
+    TRACE_ZONE("Grid::update");
+    return step(0);
+}
+
 /**
 *   Run a step.  First, we make sure the root is large enough to
 *   include the entire next generation by checking that all border
 *   nodes in the 4x4 square three levels down are empty.  Then we
 *   simply invoke the next generation method of the node.
+*   The border left this way is 2^(level-3) cells wide, and the cells
+*   can not move farther than 2^stepLog2 during the step, so the root
+*   also has to be at least stepLog2 + 3 levels high. The field uses int
+*   coordinates, so it is not grown beyond maxLevel.
 */
-void Grid::update()
+bool Grid::step(int stepLog2)
 {
-    while (root->getLevel() < 3 ||
-          root->getnw()->getPopulation() != root->
+    TRACE_ZONE("Grid::step");
+    if (!beginStep(stepLog2))
+    {
+        return false;
+    }
+    continueStep(-1);
+    return true;
+}
+
+bool Grid::advance(long long generations)
+{
+    while (generations > 0)
+    {
+        int k = 0; // the biggest step not exceeding what is left
+        while (k < TreeNode::maxStepLog2 && (2LL << k) <= generations)
+        {
+            k++;
+        }
+        if (!step(k))
+        {
+            return false;
+        }
+        generations -= 1LL << k;
+    }
+    return true;
+}
+
+bool Grid::beginStep(int stepLog2)
+{
+    cancelStep();
+    // the field is grown on the side, so that it stays as it is if it can
+    // not grow enough
+    shared_ptr<TreeNode> node = root;
+    while (node->getLevel() < 3 ||
+          node->getLevel() < stepLog2 + 3 ||
+          node->getnw()->getPopulation() != node->
                                             getnw()->
                                             getse()->
                                             getse()->
                                             getPopulation() ||
-          root->getne()->getPopulation() != root->
+          node->getne()->getPopulation() != node->
                                             getne()->
                                             getsw()->
                                             getsw()->
                                             getPopulation() ||
-          root->getsw()->getPopulation() != root->
+          node->getsw()->getPopulation() != node->
                                             getsw()->
                                             getne()->
                                             getne()->
                                             getPopulation() ||
-          root->getse()->getPopulation() != root->
+          node->getse()->getPopulation() != node->
                                             getse()->
                                             getnw()->
                                             getnw()->
                                             getPopulation())
     {
-        root = root->expandUniverse();
+        if (node->getLevel() >= maxLevel)
+        {
+            atLimit = true;
+            return false;
+        }
+        node = node->expandUniverse();
+    }
+    root = node;
+    task.start(root, stepLog2);
+    taskStepLog2 = stepLog2;
+    return true;
+}
+
+bool Grid::continueStep(qint64 nanoseconds)
+{
+    TRACE_ZONE("Grid::continueStep");
+    if (!task.isRunning())
+    {
+        return true;
+    }
+    QElapsedTimer clock;
+    clock.start();
+    bool finished;
+    if (pager == nullptr)
+    {
+        finished = task.run(nanoseconds);
+    }
+    else
+    {
+        // the step is computed in slices and the pages it read are dropped
+        // between them, when nothing but the task holds the nodes
+        do
+        {
+            qint64 slice = pageSliceNanoseconds;
+            if (nanoseconds >= 0)
+            {
+                slice = min(slice, max(nanoseconds - clock.nsecsElapsed(),
+                                       0LL));
+            }
+            finished = task.run(slice);
+            pager->trim();
+        }
+        while (!finished && (nanoseconds < 0 ||
+                             clock.nsecsElapsed() < nanoseconds));
+    }
+    EngineStats::add(EngineStats::StepNanoseconds, clock.nsecsElapsed());
+    if (!finished)
+    {
+        return false;
+    }
+    EngineStats::add(EngineStats::Steps);
+    root = task.result();
+    generationCount += 1LL << taskStepLog2;
+    return true;
+}
+
+void Grid::cancelStep()
+{
+    task.cancel();
+    atLimit = false;
+}
+
+bool Grid::isAtLimit() const
+{
+    return atLimit;
+}
+
+bool Grid::isStepping() const
+{
+    return task.isRunning();
+}
+
+double Grid::stepProgress() const
+{
+    return task.progress();
+}
+
+#ifdef QT_GUI_LIB
+void Grid::draw(Rasterizer *rasterizer,
+                const Viewport &view,
+                qint64 x,
+                qint64 y,
+                const QColor &color) const
+{
+    TRACE_ZONE("Grid::draw");
+    // a paged node reads its children when they are first looked at, so a
+    // paged tree is drawn on one thread
+    rasterizer->draw(root.get(), x - getWidth() / 2, y - getWidth() / 2,
+                     view, color, pager == nullptr);
+    if (pager != nullptr)
+    {
+        pager->trim();
+    }
+}
+
+void Grid::drawDensity(Rasterizer *rasterizer, const Viewport &view) const
+{
+    TRACE_ZONE("Grid::drawDensity");
+    rasterizer->drawDensity(root.get(), -getWidth() / 2, -getWidth() / 2,
+                            view, pager == nullptr);
+    if (pager != nullptr)
+    {
+        pager->trim();
+    }
+}
+
+QRegion Grid::changes(Rasterizer *rasterizer,
+                      const shared_ptr<const TreeNode> &before,
+                      const Viewport &view) const
+{
+    TRACE_ZONE("Grid::changes");
+    QRegion region = rasterizer->changes(before.get(), root.get(),
+                                         -getWidth() / 2, -getWidth() / 2,
+                                         view);
+    if (pager != nullptr)
+    {
+        pager->trim();
     }
-    root = root->nextGeneration();
-    generationCount++;
+    return region;
 }
+#endif
 
-void Grid::draw(QPainter* painter, int x0, int y0, float width) const
+shared_ptr<const TreeNode> Grid::getRoot() const
 {
-    root->recDraw(painter, x0, y0, width);
+    return root;
 }
 
-int Grid::getGeneration() const
+long long Grid::getGeneration() const
 {
     return generationCount;
 }
@@ -381,11 +735,13 @@ long Grid::getPopulation() const
 
 void Grid::rotateClockwise()
 {
+    cancelStep();
     root = root->rotateClockwise();
 }
 
 void Grid::rotateAntiClockwise()
 {
+    cancelStep();
     root = root->rotateAntiClockwise();
 }
 
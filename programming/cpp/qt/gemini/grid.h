@@ -9,11 +9,15 @@
 #define GRID_H
 
 #include "memory"
-#include <QPainter>
 #include <QString>
 
+#include "fileprogress.h"
+#include "generationtask.h"
+#include "rasterizer.h"
 #include "treenode.h"
 
+class NodePager;
+
 using namespace std;
 
 class Grid
@@ -21,8 +25,17 @@ class Grid
 private:
     // WARNING! in this file, "grid" means "field", that is, automaton itself
     // while in gridpainter.h and .cpp "grid" means "lines like on graph paper"
-    int generationCount; // number of a generation passed since creation
+    long long generationCount; // number of a generation passed since creation
     shared_ptr<TreeNode> root; // actually a grid
+    GenerationTask task; // the step being computed by continueStep
+    int taskStepLog2;    // the size of that step
+    bool atLimit;        // the last beginStep would have made the field
+                         // bigger than 2^maxLevel
+    shared_ptr<NodePager> pager; // of the snapshot opened with openPaged
+
+    // a paged step is computed in slices this long, the pages read being
+    // dropped after each
+    static const qint64 pageSliceNanoseconds = 10000000;
 public:
 
     // == initEmptyGrid(80, 25);
@@ -34,15 +47,59 @@ public:
     // fills a rectangle (width, height) with random cells
     void initRandom(int width, int height);
 
-    // returns true if parsing is successful; false otherwise
-    bool parsePlainText(const QString &fileName);
-
-    // returns true if parsing is successful; false otherwise
-    bool parseRLE(const QString &fileName);
-
-    // Writes current field into file "fileName"
-    void saveAsPlainText(const QString &fileName);
-    void saveAsRLE(const QString &fileName);
+    // The files are read and written with the progress reported to
+    // "progress", if given; cancelling it makes them fail. A Grid may be
+    // loaded or saved on another thread while other Grids are used: nodes
+    // are never changed, only made, and the hash of results is not used.
+    // Paged Grids are the exception and must stay on their thread
+
+    // plain text (.cells), Life 1.05 and Life 1.06, told apart by the first
+    // line; returns true if parsing is successful; false otherwise, and
+    // then the field is not changed
+    bool parsePlainText(const QString &fileName,
+                        FileProgress *progress = nullptr);
+
+    // returns true if parsing is successful; false otherwise, and then the
+    // field is not changed. The pattern is put in the centre if the file
+    // has the "x = , y = " header
+    bool parseRLE(const QString &fileName, FileProgress *progress = nullptr);
+
+    // Golly macrocell format: the nodes of the tree are written one per
+    // line, every distinct node once, so loading and saving take time
+    // proportional to the number of distinct nodes, not cells. The
+    // generation is kept too. On failure the field is not changed
+    bool parseMacrocell(const QString &fileName,
+                        FileProgress *progress = nullptr);
+
+    // binary snapshot (see snapshot.h): the node table, the generation and
+    // the step in progress, which is started again after loading. On
+    // failure the field is not changed
+    bool parseSnapshot(const QString &fileName,
+                       FileProgress *progress = nullptr);
+
+    // opens a snapshot without reading it: nodes are read from the mapped
+    // file when something looks at them, and dropped again when more than
+    // the page budget are read (see nodepager.h). The file must not change
+    // while it is open. On failure the field is not changed
+    bool openPaged(const QString &fileName);
+
+    // true if the field was opened with openPaged
+    bool isPaged() const;
+
+    // see NodePager::setBudget; for the field opened with openPaged
+    void setPageBudget(int nodes);
+
+    // Writes current field into file "fileName". They return false if the
+    // file could not be written, and then it is not changed
+    bool saveAsPlainText(const QString &fileName,
+                         FileProgress *progress = nullptr) const;
+    // the bounding box of the living cells is written, row by row
+    bool saveAsRLE(const QString &fileName,
+                   FileProgress *progress = nullptr) const;
+    bool saveAsMacrocell(const QString &fileName,
+                         FileProgress *progress = nullptr) const;
+    bool saveAsSnapshot(const QString &fileName,
+                        FileProgress *progress = nullptr) const;
 
     // kill all cells without any changes to the size of the grid
     void clear();
@@ -53,6 +110,7 @@ public:
     // true if root[heightIndex][widthIndex] is alive
     bool isAlive(int heightIndex, int widthIndex) const;
 
+    // cells beyond the biggest field (2^maxLevel wide) are left out
     void setAlive(int heightIndex, int widthIndex, bool isAlive);
 
     int getWidth() const;
@@ -60,13 +118,64 @@ public:
     int getHeight() const;
 
     // calculates next generation and expands this if not all the cells fit
-    void update();
-
-    // draws itself so that (x0, y0) is in the center
-    void draw(QPainter* painter, int x0, int y0, float width) const;
+    // returns false, as step does, if it can not
+    bool update();
+
+    // advances the field by 2^stepLog2 generations at once
+    // (0 <= stepLog2 <= TreeNode::maxStepLog2); returns false, and leaves
+    // the field as it is, if it would have to grow beyond 2^maxLevel
+    bool step(int stepLog2);
+
+    // advances the field by any number of generations, making the biggest
+    // steps first; returns false if it stopped at the limit of step
+    bool advance(long long generations);
+
+    // The same as step, but in portions: beginStep prepares the step, or
+    // returns false at the limit of step, and continueStep computes it for
+    // about "nanoseconds" (negative - until it is done) and returns true
+    // when the field has been advanced.
+    // Any change of the field cancels the step that is not finished
+    bool beginStep(int stepLog2);
+    bool continueStep(qint64 nanoseconds);
+    void cancelStep();
+
+    // true if the last beginStep failed as the field can grow no more;
+    // any change of the field clears it
+    bool isAtLimit() const;
+
+    // true between beginStep and the end of the step
+    bool isStepping() const;
+
+    // the part of the current step done so far, from 0 to 1
+    double stepProgress() const;
+
+#ifdef QT_GUI_LIB
+    // draws its living cells in "color" through "view", with cell (0, 0)
+    // of the field on cell (x, y) of the view; only the part inside the
+    // image of the rasterizer is visited
+    void draw(Rasterizer *rasterizer,
+              const Viewport &view,
+              qint64 x,
+              qint64 y,
+              const QColor &color) const;
+
+    // the same for the field on cell (0, 0), but colours each pixel by the
+    // density of the living cells in it (see Rasterizer::drawDensity)
+    void drawDensity(Rasterizer *rasterizer, const Viewport &view) const;
+
+    // the part of the image of the rasterizer, drawn as by drawDensity, in
+    // which this field differs from the tree "before" taken by getRoot
+    QRegion changes(Rasterizer *rasterizer,
+                    const shared_ptr<const TreeNode> &before,
+                    const Viewport &view) const;
+#endif
+
+    // the tree of the field; trees are never changed, so it can be kept
+    // to be compared with the field later
+    shared_ptr<const TreeNode> getRoot() const;
 
     // returns generationCount
-    int getGeneration() const;
+    long long getGeneration() const;
 
     // returns the number of living cells
     long getPopulation() const;
@@ -92,6 +201,9 @@ public:
     QVector<QVector<int> > as2dArray() const;
 
     int hashSize();
+
+    // the field uses int coordinates, so its side is at most 2^maxLevel
+    static const int maxLevel = 30;
 };
 
 #endif // GRID_H
@@ -10,35 +10,32 @@
 #include <QApplication>
 #include <QPaintEvent>
 #include <QPainter>
+#include <QPixmap>
 #include <QPaintEvent>
+#include <QtConcurrent>
 #include <QtWidgets>
 #include <QWidget>
 
+#include "enginestats.h"
 #include "gridpainter.h"
+#include "tracer.h"
 
-GridPainter::GridPainter(QWidget *parent) : QOpenGLWidget(parent)
+GridPainter::GridPainter(QWidget *parent) : QWidget(parent)
 {
+    // a plain widget is painted into the backing store, which keeps the
+    // rest of the last frame, so update(region) paints only the region;
+    // every pixel of it is painted, so it need not be cleared first
+    setAttribute(Qt::WA_OpaquePaintEvent);
     stopped = true;
 
     grid.initEmptyGrid(1000, 1000);
-
-    topLeftDrawingPosition = QPoint(-grid.getWidth() * 5,
-                                    -grid.getWidth() * 5);
-
-    // taking grid.getWidth() * 5 ensures that cell size will be more than 1
-    // if the size of a cell is less than one, the program won't work correctly
-    bottomRightDrawingPosition = QPoint(grid.getWidth() * 5,
-                                        grid.getWidth() * 5);
+    // the viewport starts with the centre of the field in the centre of
+    // the widget, cells 10 pixels wide
 
     cellColor = QColor(0, 0, 0);
     spaceColor = QColor(255, 255, 255);
-    gridColor = QColor(230, 230, 230);
-
-    cellBrush.setColor(cellColor);
-    cellBrush.setStyle(Qt::SolidPattern);
-
-    gridPen.setColor(gridColor);
-    gridPen.setStyle(Qt::SolidLine);
+    setGridColor(QColor(230, 230, 230));
+    heatmap = false;
 
     mouseScrollSensitivity = 1.3;
 
@@ -50,81 +47,38 @@ GridPainter::GridPainter(QWidget *parent) : QOpenGLWidget(parent)
 
     currentPaintingIndex = 0;
     currentErasingIndex = 0;
+
+    fileBusy = false;
+    fileLoading = false;
+    connect(&fileWatcher, SIGNAL(finished()), this, SLOT(fileDone()));
+}
+
+GridPainter::~GridPainter()
+{
+    fileProgress.cancel();
+    fileWatcher.waitForFinished();
 }
 
 void GridPainter::autoFitDrawingPoints()
 {
+    // boundaries are counted from the corner of the field, the viewport
+    // from its centre
+    int half = grid.getWidth() / 2;
     int left = grid.leftBoundary();
-    int right = grid.rightBoundary();
-    int bottom = grid.bottomBoundary();
     int top = grid.topBoundary();
-    // cellWidth is maximal possible width of a cell so that all the cells fit
-    // into the screen
-    int cellWidth;
-    int width = right - left;
-    int height = bottom - top;
-    if (this->width() / this->height() > width / height)
-    {
-        if (width < this->width())
-        {
-            cellWidth = this->height() / height;
-        }
-        else
-        {
-            cellWidth = 1;
-        }
-    }
-    else
+    viewport.setSize(size());
+    viewport.fit(left - half,
+                 top - half,
+                 grid.rightBoundary() - left + 1,
+                 grid.bottomBoundary() - top + 1);
+    double scale = viewport.getScale();
+    if (scale >= 1)
     {
-        if (height < this->height())
-        {
-            cellWidth = this->width() / width;
-        }
-        else
-        {
-            cellWidth = 1;
-        }
+        viewport.setScale(floor(scale));
     }
-    topLeftDrawingPosition = QPoint(-left * cellWidth, -top * cellWidth);
-    int leftCoord = topLeftDrawingPosition.x();
-    int topCoord = topLeftDrawingPosition.y();
-    bottomRightDrawingPosition = QPoint(leftCoord + grid.getWidth() * cellWidth,
-                                        topCoord + grid.getWidth() * cellWidth);
-}
-
-void GridPainter::preventResizing(int prevGridWidth,
-                                  int currentGridWidth,
-                                  int prevFieldWidth)
-{
-    if (prevGridWidth != currentGridWidth) // prevent unneeded resizing
+    else
     {
-        int prevWidth = bottomRightDrawingPosition .x() -
-                             topLeftDrawingPosition.x();
-        if (prevGridWidth < currentGridWidth)
-        {
-            topLeftDrawingPosition.setX(topLeftDrawingPosition.x() -
-                                        prevFieldWidth / 2);
-            topLeftDrawingPosition.setY(topLeftDrawingPosition.y() -
-                                        prevFieldWidth / 2);
-            bottomRightDrawingPosition.setX(bottomRightDrawingPosition.x() +
-                                            prevFieldWidth / 2);
-            bottomRightDrawingPosition.setY(bottomRightDrawingPosition.y() +
-                                            prevFieldWidth / 2);
-
-        }
-        else
-        {
-            topLeftDrawingPosition.setX(topLeftDrawingPosition.x() +
-                                        prevFieldWidth / 4);
-            topLeftDrawingPosition.setY(topLeftDrawingPosition.y() +
-                                        prevFieldWidth / 4);
-            bottomRightDrawingPosition.setX(bottomRightDrawingPosition.x() -
-                                            prevWidth / 4);
-            bottomRightDrawingPosition.setY(bottomRightDrawingPosition.y() -
-                                            prevWidth / 4);
-
-        }
-
+        viewport.setScale(pow(2.0, floor(log2(scale))));
     }
 }
 
@@ -132,21 +86,27 @@ void GridPainter::animate()
 {
     if (!stopped)
     {
-        int prevGridWidth = grid.getWidth();
-        grid.update();
-        int currentGridWidth = grid.getWidth();
-        preventResizing(prevGridWidth,
-                        currentGridWidth,
-                        bottomRightDrawingPosition.x() -
-                            topLeftDrawingPosition.x());
-
-        update();
+        shared_ptr<const TreeNode> before = grid.getRoot();
+        scheduler.advance(grid);
+        updateChanges(before);
+        if (grid.isAtLimit())
+        {
+            stopped = true;
+            scheduler.reset();
+            emit limitReached();
+        }
     }
 }
 
 void GridPainter::stopPressed()
 {
     stopped = !stopped;
+    if (stopped)
+    {
+        // do not keep the half-computed step: the user may change the field
+        grid.cancelStep();
+    }
+    scheduler.reset();
 }
 
 void GridPainter::clear()
@@ -171,22 +131,26 @@ void GridPainter::nextGeneration()
 {
     if (stopped)
     {
-        int prevGridWidth = grid.getWidth();
-        grid.update();
-        int currentGridWidth = grid.getWidth();
-        preventResizing(prevGridWidth,
-                        currentGridWidth,
-                        bottomRightDrawingPosition.x() -
-                            topLeftDrawingPosition.x());
-        update();
+        shared_ptr<const TreeNode> before = grid.getRoot();
+        if (!grid.update())
+        {
+            emit limitReached();
+        }
+        updateChanges(before);
     }
 }
 
+void GridPainter::updateChanges(const shared_ptr<const TreeNode> &before)
+{
+    // the field grows and shrinks around its centre, so the viewport
+    // stays; a field of another size has its cells in other nodes, and is
+    // painted again whole (see Rasterizer::changes)
+    update(grid.changes(&rasterizer, before, viewport));
+}
+
 void GridPainter::setCellColor(QColor cc)
 {
     cellColor = cc;
-
-    cellBrush.setColor(cellColor);
 }
 
 void GridPainter::setSpaceColor(QColor sc)
@@ -197,11 +161,32 @@ void GridPainter::setSpaceColor(QColor sc)
 void GridPainter::setGridColor(QColor gc)
 {
     gridColor = gc;
+    // major lines stand out from the grid the way cells do: darker on a
+    // light grid, lighter on a dark one
+    if (gridColor.lightness() > 127)
+    {
+        majorGridColor = gridColor.darker(130);
+    }
+    else
+    {
+        majorGridColor = gridColor.lighter(160);
+    }
 
-    gridPen.setColor(gridColor);
+    gridBrushCellWidth = 0; // made again with the new colors
+}
+
+void GridPainter::setHeatmapColors(QColor sparse, QColor dense)
+{
+    rasterizer.setColorMap(sparse, dense);
 }
 
-int GridPainter::getGenerationCount()
+void GridPainter::setHeatmap(bool on)
+{
+    heatmap = on;
+    update();
+}
+
+long long GridPainter::getGenerationCount()
 {
     return grid.getGeneration();
 }
@@ -211,35 +196,199 @@ long GridPainter::getPopulation()
     return grid.getPopulation();
 }
 
+const Grid &GridPainter::getGrid()
+{
+    return grid;
+}
+
+QRectF GridPainter::getViewport()
+{
+    double side = grid.getWidth();
+    QRectF cells = viewport.visibleCells();
+    QRectF view((cells.x() + side / 2) / side,
+                (cells.y() + side / 2) / side,
+                cells.width() / side,
+                cells.height() / side);
+    return view & QRectF(0, 0, 1, 1);
+}
+
+void GridPainter::centerOn(const QPointF &point)
+{
+    double side = grid.getWidth();
+    viewport.centerOn((point.x() - 0.5) * side, (point.y() - 0.5) * side);
+    update();
+}
+
+void GridPainter::setTargetRate(double generationsPerSecond)
+{
+    scheduler.setTargetRate(generationsPerSecond);
+}
+
+double GridPainter::getTargetRate()
+{
+    return scheduler.getTargetRate();
+}
+
+void GridPainter::setFrameBudget(int milliseconds)
+{
+    scheduler.setFrameBudget(milliseconds);
+}
+
+int GridPainter::getFrameBudget()
+{
+    return scheduler.getFrameBudget();
+}
+
+double GridPainter::getAchievedRate()
+{
+    return isStopped() ? 0 : scheduler.getAchievedRate();
+}
+
+int GridPainter::getStepLog2()
+{
+    return scheduler.getStepLog2();
+}
+
+double GridPainter::getStepProgress()
+{
+    return grid.stepProgress();
+}
+
 void GridPainter::initEmptyGrid(int width, int height)
 {
     grid.initEmptyGrid(width, height);
 }
 
-bool GridPainter::parsePlainText(const QString &fileName)
+bool GridPainter::loadFile(Grid *grid,
+                           FILE_FORMAT format,
+                           const QString &fileName,
+                           FileProgress *progress)
 {
-    stopped = true;
-    bool success = grid.parsePlainText(fileName);
-    autoFitDrawingPoints();
-    return success;
+    if (format == RLE)
+    {
+        return grid->parseRLE(fileName, progress);
+    }
+    if (format == MACROCELL)
+    {
+        return grid->parseMacrocell(fileName, progress);
+    }
+    if (format == SNAPSHOT)
+    {
+        return grid->parseSnapshot(fileName, progress);
+    }
+    return grid->parsePlainText(fileName, progress);
 }
 
-bool GridPainter::parseRLE(const QString &fileName)
+bool GridPainter::saveFile(const Grid *grid,
+                           FILE_FORMAT format,
+                           const QString &fileName,
+                           FileProgress *progress)
 {
-    stopped = true;
-    bool success = grid.parseRLE(fileName);
-    autoFitDrawingPoints();
-    return success;
+    if (format == RLE)
+    {
+        return grid->saveAsRLE(fileName, progress);
+    }
+    if (format == MACROCELL)
+    {
+        return grid->saveAsMacrocell(fileName, progress);
+    }
+    if (format == SNAPSHOT)
+    {
+        return grid->saveAsSnapshot(fileName, progress);
+    }
+    return grid->saveAsPlainText(fileName, progress);
 }
 
-void GridPainter::saveAsPlainText(const QString &fileName)
+bool GridPainter::startLoading(FILE_FORMAT format, const QString &fileName)
 {
-    grid.saveAsPlainText(fileName);
+    if (isBusyWithFile())
+    {
+        return false;
+    }
+    fileProgress.reset();
+    fileBusy = true;
+    fileLoading = true;
+    this->fileName = fileName;
+    fileWatcher.setFuture(QtConcurrent::run(loadFile, &fileGrid, format,
+                                            fileName, &fileProgress));
+    return true;
+}
+
+/**
+*   The field is copied, which copies the pointer to its root only, and
+*   the copy is written: nodes are never changed, so the current field may
+*   go on meanwhile. Nodes of a paged field are changed when they are read,
+*   so it is written on this thread.
+*/
+bool GridPainter::startSaving(FILE_FORMAT format, const QString &fileName)
+{
+    if (isBusyWithFile())
+    {
+        return false;
+    }
+    fileProgress.reset();
+    fileBusy = true;
+    fileLoading = false;
+    this->fileName = fileName;
+    if (grid.isPaged())
+    {
+        bool success = saveFile(&grid, format, fileName, &fileProgress);
+        // fileFinished is emitted later, as it is for the other fields
+        QMetaObject::invokeMethod(this,
+                                  "finishFile",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(bool, success));
+        return true;
+    }
+    fileGrid = grid;
+    fileWatcher.setFuture(QtConcurrent::run(saveFile, &fileGrid, format,
+                                            fileName, &fileProgress));
+    return true;
+}
+
+bool GridPainter::isBusyWithFile()
+{
+    return fileBusy;
+}
+
+double GridPainter::getFileProgress()
+{
+    return fileProgress.fraction();
+}
+
+void GridPainter::cancelFile()
+{
+    fileProgress.cancel();
+}
+
+void GridPainter::fileDone()
+{
+    finishFile(fileWatcher.result());
+}
+
+void GridPainter::finishFile(bool success)
+{
+    success = success && !fileProgress.isCancelled();
+    if (fileLoading && success)
+    {
+        stopped = true;
+        grid = fileGrid;
+        scheduler.reset();
+        autoFitDrawingPoints();
+        update();
+    }
+    // the field read or written is not needed any more
+    fileGrid = Grid();
+    fileBusy = false;
+    emit fileFinished(fileLoading, success, fileName);
 }
 
-void GridPainter::saveAsRLE(const QString &fileName)
+bool GridPainter::openPaged(const QString &fileName)
 {
-    grid.saveAsRLE(fileName);
+    stopped = true;
+    bool success = grid.openPaged(fileName);
+    autoFitDrawingPoints();
+    return success;
 }
 
 void GridPainter::initRandom(int width, int height)
@@ -315,93 +464,210 @@ int GridPainter::getHashSize()
     return grid.hashSize();
 }
 
-void GridPainter::paintEvent(QPaintEvent *event)
+long long GridPainter::getCounter(EngineStats::Counter counter)
 {
-    QPainter *painter = new QPainter;
-    painter->begin(this);
-
-    painter->fillRect(event->rect(), spaceColor);
+    return EngineStats::get(counter);
+}
 
-    painter->setBrush(cellBrush);
+long long GridPainter::getNodesAlive()
+{
+    return EngineStats::getNodesAlive();
+}
 
-    int fieldWidth = (bottomRightDrawingPosition.x() -
-                          topLeftDrawingPosition.x());
+long long GridPainter::getNodesCreated()
+{
+    return EngineStats::getNodesCreated();
+}
 
-    painter->save();
-    painter->setPen(Qt::NoPen);
-    grid.draw(painter,
-              topLeftDrawingPosition.x() + fieldWidth / 2,
-              topLeftDrawingPosition.y() + fieldWidth / 2,
-              fieldWidth);
+QVector<long long> GridPainter::getNodesAlivePerLevel()
+{
+    QVector<long long> alive;
+    for (int i = 0; i <= EngineStats::maxLevel; i++)
+    {
+        alive.push_back(EngineStats::getNodesAlive(i));
+    }
+    return alive;
+}
 
-    int mouseX = mousePosition.x() - topLeftDrawingPosition.x();
-    int mouseY = mousePosition.y() - topLeftDrawingPosition.y();
+QVector<long long> GridPainter::getNodesCreatedPerLevel()
+{
+    QVector<long long> created;
+    for (int i = 0; i <= EngineStats::maxLevel; i++)
+    {
+        created.push_back(EngineStats::getNodesCreated(i));
+    }
+    return created;
+}
 
-    int cellWidth = fieldWidth / grid.getWidth();
+long long GridPainter::getBytesInUse()
+{
+    return EngineStats::getBytesInUse();
+}
 
-    mouseX /= cellWidth;
-    mouseY /= cellWidth;
+void GridPainter::paintEvent(QPaintEvent *event)
+{
+    TRACE_ZONE("GridPainter::paintEvent");
+    // the cell under the mouse, where the pattern would be put
+    qint64 mouseX = mouseCellX();
+    qint64 mouseY = mouseCellY();
+    bool preview = mouseInReach();
+
+    // the painter lives on the stack, so it is ended and freed with the
+    // frame
+    QPainter painter(this);
+
+    // cells are written into the image of the rasterizer, which is then
+    // shown at once; only the grid lines are left to the painter. The
+    // image keeps the previous frame, so only the rectangles being painted
+    // are drawn again
+    QVector<QRect> rects = event->region().rects();
+    for (int i = 0; i < rects.size(); i++)
+    {
+        QRect area = rasterizer.begin(size(), spaceColor, rects[i]);
 
-    mouseX = topLeftDrawingPosition.x() + mouseX * cellWidth;
-    mouseY = topLeftDrawingPosition.y() + mouseY * cellWidth;
+        if (heatmap)
+        {
+            grid.drawDensity(&rasterizer, viewport);
+        }
+        else
+        {
+            grid.draw(&rasterizer, viewport, 0, 0, cellColor);
+        }
 
-    // if the mouse is inside the field
-    if (mouseX >     topLeftDrawingPosition.x() &&
-        mouseY >     topLeftDrawingPosition.y() &&
-        mouseX < bottomRightDrawingPosition.x() &&
-        mouseY < bottomRightDrawingPosition.y())
-    {
-        if (mode == DRAWING)
+        if (preview && mode == DRAWING)
         {
             // draw the pattern that is about to be inserted
-            painter->setBrush(cellBrush);
-            float paintingWidth = painting[currentPaintingIndex].getWidth()
-                                      * cellWidth;
-            painting[currentPaintingIndex].draw(painter,
+            painting[currentPaintingIndex].draw(&rasterizer,
+                                                viewport,
                                                 mouseX,
                                                 mouseY,
-                                                paintingWidth);
+                                                cellColor);
         }
 
-        if (mode == ERASING)
+        if (preview && mode == ERASING)
         {
             // draw the pattern that is about to be erased with
-            painter->setBrush(QBrush(gridColor));
-            float erasingWidth = erasing[currentErasingIndex].getWidth()
-                                      * cellWidth;
-            erasing[currentErasingIndex].draw(painter,
-                                                mouseX,
-                                                mouseY,
-                                                erasingWidth);
+            erasing[currentErasingIndex].draw(&rasterizer,
+                                              viewport,
+                                              mouseX,
+                                              mouseY,
+                                              gridColor);
         }
+
+        painter.drawImage(area, rasterizer.getImage(), area);
+        EngineStats::add(EngineStats::RepaintedPixels,
+                         (long long)area.width() * area.height());
     }
+    EngineStats::add(EngineStats::WidgetPixels,
+                     (long long)width() * height());
 
-    if (cellWidth > 3) // if a cell is big enough, then draw the grid
+    // if a cell is big enough, then draw the grid
+    if (viewport.getScale() > minGridCellWidth)
     {
-        painter->setPen(gridPen);
-        for (int i = topLeftDrawingPosition.x() % cellWidth;
-                i < event->rect().width();
-                i += cellWidth)
-        {
-            painter->drawLine(i,
-                              0,
-                              i,
-                              event->rect().height());
-        }
-        for (int i = topLeftDrawingPosition.y() % cellWidth;
-                i < event->rect().height();
-                i += cellWidth)
-        {
-            painter->drawLine(0,
-                              i,
-                              event->rect().width(),
-                              i);
-        }
+        drawGrid(&painter);
     }
+}
 
-    painter->restore();
+void GridPainter::resizeEvent(QResizeEvent *event)
+{
+    // the cell in the centre stays in the centre
+    viewport.setSize(event->size());
+    QWidget::resizeEvent(event);
+}
 
-    painter->end();
+/**
+*   The lines of a square of majorGridInterval cells are drawn once into
+*   a brush, which is tiled over the widget from a major line, so a frame
+*   costs one fill however many lines there are. Cells too big for such a
+*   square, or not a whole number of pixels wide, have their lines drawn
+*   one by one. The painter leaves out what is outside the painted region.
+*/
+void GridPainter::drawGrid(QPainter *painter)
+{
+    int cellWidth = (int)viewport.getScale();
+    int majorWidth = cellWidth * majorGridInterval;
+    if (cellWidth != viewport.getScale() || majorWidth > maxGridBrushSize)
+    {
+        drawViewportLines(painter, 1, gridColor);
+        drawViewportLines(painter, majorGridInterval, majorGridColor);
+        return;
+    }
+    if (gridBrushCellWidth != cellWidth)
+    {
+        QPixmap tile(majorWidth, majorWidth);
+        tile.fill(Qt::transparent);
+        QPainter tilePainter(&tile);
+        drawGridLines(&tilePainter, QPoint(0, 0), tile.size(),
+                      cellWidth, gridColor);
+        drawGridLines(&tilePainter, QPoint(0, 0), tile.size(),
+                      majorWidth, majorGridColor);
+        tilePainter.end();
+        gridBrush.setTexture(tile);
+        gridBrushCellWidth = cellWidth;
+    }
+    // a major line near the widget, as cell 0 may be far from it
+    qint64 x = viewport.cellX(0);
+    qint64 y = viewport.cellY(0);
+    x -= (x % majorGridInterval + majorGridInterval) % majorGridInterval;
+    y -= (y % majorGridInterval + majorGridInterval) % majorGridInterval;
+    painter->setBrushOrigin((int)floor(viewport.pixelX(x)),
+                            (int)floor(viewport.pixelY(y)));
+    painter->fillRect(rect(), gridBrush);
+}
+
+void GridPainter::drawGridLines(QPainter *painter,
+                                const QPoint &origin,
+                                const QSize &size,
+                                int spacing,
+                                const QColor &color)
+{
+    painter->setPen(color);
+    for (int i = origin.x() % spacing;
+            i < size.width();
+            i += spacing)
+    {
+        painter->drawLine(i,
+                          0,
+                          i,
+                          size.height());
+    }
+    for (int i = origin.y() % spacing;
+            i < size.height();
+            i += spacing)
+    {
+        painter->drawLine(0,
+                          i,
+                          size.width(),
+                          i);
+    }
+}
+
+void GridPainter::drawViewportLines(QPainter *painter,
+                                    int interval,
+                                    const QColor &color)
+{
+    painter->setPen(color);
+    // the first line at the left and top edges of the widget or before
+    qint64 x = viewport.cellX(0);
+    qint64 y = viewport.cellY(0);
+    x -= (x % interval + interval) % interval;
+    y -= (y % interval + interval) % interval;
+    for (; viewport.pixelX(x) < width(); x += interval)
+    {
+        int i = (int)floor(viewport.pixelX(x));
+        painter->drawLine(i,
+                          0,
+                          i,
+                          height());
+    }
+    for (; viewport.pixelY(y) < height(); y += interval)
+    {
+        int i = (int)floor(viewport.pixelY(y));
+        painter->drawLine(0,
+                          i,
+                          width(),
+                          i);
+    }
 }
 
 void GridPainter::setMouseMode(MOUSE_MODE m)
@@ -415,69 +681,29 @@ void GridPainter::wheelEvent(QWheelEvent *event)
     switch(mode)
     {
     case MOVING:
-    {
-        int mouseX = event->pos().x();
-        int mouseY = event->pos().y();
-        if (topLeftDrawingPosition.x()    < mouseX &&
-           bottomRightDrawingPosition.x() > mouseX &&
-           topLeftDrawingPosition.y()     < mouseY &&
-           bottomRightDrawingPosition.y() > mouseY)
+        if (event->orientation() == Qt::Vertical)
         {
-            update();
-            int cellWidth = (bottomRightDrawingPosition.x() -
-                                 topLeftDrawingPosition.x()) / grid.getWidth();
-            int leftPart = grid.getWidth() * (mouseX -
-                                              topLeftDrawingPosition.x()) /
-                           (bottomRightDrawingPosition.x() -
-                                topLeftDrawingPosition.x());
-            int rightPart = grid.getWidth() - leftPart;
-            int topPart = grid.getWidth() * (mouseY -
-                                             topLeftDrawingPosition.y()) /
-                          (bottomRightDrawingPosition.y() -
-                               topLeftDrawingPosition.y());
-            int bottomPart = grid.getWidth() - topPart;
-
-            if (event->delta() > 0)
+            // a step of the wheel is 120; finer wheels zoom by less at a
+            // time, so the zoom is as smooth as the wheel is
+            double scale = viewport.getScale() *
+                           pow(mouseScrollSensitivity, event->delta() / 120.0);
+            if (scale >= 1 && event->delta() != 0)
             {
-                if (event->orientation() == Qt::Vertical)
+                // cells stay a whole number of pixels wide, so that the grid
+                // is drawn from its brush; a step changes the width by one
+                // pixel at least
+                double cellWidth = round(scale);
+                if (cellWidth == viewport.getScale())
                 {
-                    // if the scrolling has any effect
-                    if (floor(cellWidth * mouseScrollSensitivity) > 1 &&
-                       floor(cellWidth * mouseScrollSensitivity) != cellWidth)
-                    {
-                        cellWidth *= mouseScrollSensitivity;
-                    }
-                    else
-                    {
-                        cellWidth += 1;
-                    }
-
+                    cellWidth += event->delta() > 0 ? 1 : -1;
                 }
-            }
-            else
-            {
-                if (event->delta() < 0)
+                if (cellWidth >= 1)
                 {
-                    if (event->orientation() == Qt::Vertical)
-                    {
-                        // cellWidth should not be less than one pixel
-                        if (floor(cellWidth / mouseScrollSensitivity) > 0)
-                        {
-                            cellWidth /= mouseScrollSensitivity;
-                        }
-                    }
+                    scale = cellWidth;
                 }
             }
-            topLeftDrawingPosition.setX(event->pos().x() -
-                                        leftPart * cellWidth);
-            topLeftDrawingPosition.setY(event->pos().y() -
-                                        topPart * cellWidth);
-            bottomRightDrawingPosition.setX(event->pos().x() +
-                                            rightPart * cellWidth);
-            bottomRightDrawingPosition.setY(event->pos().y() +
-                                            bottomPart * cellWidth);
+            viewport.zoom(scale / viewport.getScale(), event->pos());
         }
-    }
     break;
     case DRAWING:
         if (event->delta() > 0)
@@ -524,63 +750,30 @@ void GridPainter::wheelEvent(QWheelEvent *event)
 
 void GridPainter::mousePressEvent(QMouseEvent *event)
 {
-    int mouseX = mousePosition.x();
-    int mouseY = mousePosition.y();
-    // if the mouse is inside the field
-    if (mouseX >     topLeftDrawingPosition.x() &&
-        mouseY >     topLeftDrawingPosition.y() &&
-        mouseX < bottomRightDrawingPosition.x() &&
-        mouseY < bottomRightDrawingPosition.y())
+    if (mouseInReach())
     {
-        int fieldWidth = (bottomRightDrawingPosition.x() -
-                              topLeftDrawingPosition.x());
-
-        mouseX -= topLeftDrawingPosition.x();
-        mouseY -= topLeftDrawingPosition.y();
-
-        int cellWidth = fieldWidth / grid.getWidth();
-
-        mouseX /= cellWidth;
-        mouseY /= cellWidth;
-
-        mouseX -= grid.getWidth() / 2;
-        mouseY -= grid.getWidth() / 2;
+        // cells are counted from the centre of the field, as the viewport
+        // does, and the field grows around its centre to take the pattern
+        int mouseX = (int)mouseCellX();
+        int mouseY = (int)mouseCellY();
 
         switch(mode)
         {
         case MOVING:
         break;
         case DRAWING:
-        {
-            int oldGridWidth = grid.getWidth();
             grid.insertPattern(painting[currentPaintingIndex],
                                mouseY, // not a bug
                                mouseX, // y, then x
                                true);  // we are painting, therefore the new
                                        // cells will be alive
-            if (oldGridWidth != grid.getWidth())
-            {
-                preventResizing(oldGridWidth,
-                                grid.getWidth(),
-                                bottomRightDrawingPosition.x() -
-                                    topLeftDrawingPosition.x());
-            }
-        }
         break;
         case ERASING:
-            int oldGridWidth = grid.getWidth();
             grid.insertPattern(erasing[currentErasingIndex],
                                mouseY, // not a bug
                                mouseX, // y, then x
                                false); // we are erasing, therefore the new
                                        // cells will be dead
-            if (oldGridWidth != grid.getWidth())
-            {
-                preventResizing(oldGridWidth,
-                                grid.getWidth(),
-                                bottomRightDrawingPosition.x() -
-                                    topLeftDrawingPosition.x());
-            }
         break;
         }
     }
@@ -594,19 +787,8 @@ void GridPainter::mouseMoveEvent(QMouseEvent *event)
     case MOVING:
         if ((event->buttons() & Qt::LeftButton))
         {
-            topLeftDrawingPosition.setX(topLeftDrawingPosition.x() +
-                                            event->pos().x() -
-                                            mousePosition.x());
-            topLeftDrawingPosition.setY(topLeftDrawingPosition.y() +
-                                            event->pos().y() -
-                                            mousePosition.y());
-
-            bottomRightDrawingPosition.setX(bottomRightDrawingPosition.x() +
-                                            event->pos().x() -
-                                            mousePosition.x());
-            bottomRightDrawingPosition.setY(bottomRightDrawingPosition.y() +
-                                            event->pos().y() -
-                                            mousePosition.y());
+            viewport.moveBy(event->pos().x() - mousePosition.x(),
+                            event->pos().y() - mousePosition.y());
         }
     case DRAWING:
     case ERASING:
@@ -615,6 +797,24 @@ void GridPainter::mouseMoveEvent(QMouseEvent *event)
     update();
 }
 
+qint64 GridPainter::mouseCellX()
+{
+    return viewport.cellX(mousePosition.x());
+}
+
+qint64 GridPainter::mouseCellY()
+{
+    return viewport.cellY(mousePosition.y());
+}
+
+bool GridPainter::mouseInReach()
+{
+    // a field growing to take a pattern farther than this would be wider
+    // than Grid::maxLevel allows
+    qint64 reach = 1 << (Grid::maxLevel - 2);
+    return qAbs(mouseCellX()) < reach && qAbs(mouseCellY()) < reach;
+}
+
 void GridPainter::hoverMove(QHoverEvent *event)
 {
     mousePosition.setX(event->pos().x());
@@ -8,17 +8,25 @@
 #ifndef GRIDPAINTER
 #define GRIDPAINTER
 
-#include <QBrush>
 #include <QMouseEvent>
-#include <QOpenGLWidget>
+#include <QPainter>
 #include <QPaintEvent>
-#include <QPen>
+#include <QPointF>
+#include <QRectF>
+#include <QResizeEvent>
+#include <QBrush>
 #include <QColor>
+#include <QFutureWatcher>
 #include <QVector>
 #include <QWheelEvent>
 #include <QWidget>
 
+#include "enginestats.h"
+#include "fileprogress.h"
 #include "grid.h"
+#include "rasterizer.h"
+#include "stepscheduler.h"
+#include "viewport.h"
 
 enum MOUSE_MODE
 {
@@ -27,7 +35,15 @@ enum MOUSE_MODE
     ERASING
 };
 
-class GridPainter : public QOpenGLWidget
+enum FILE_FORMAT
+{
+    PLAIN_TEXT,
+    RLE,
+    MACROCELL,
+    SNAPSHOT
+};
+
+class GridPainter : public QWidget
 {
     Q_OBJECT
 private:
@@ -39,63 +55,158 @@ private:
     int currentErasingIndex;  // exact pattern used for erasing
 
     bool stopped;             // true if the field is updating continuously
+
+    StepScheduler scheduler;  // decides how far the field goes every frame
     
     QColor cellColor;         // color of a living cell
     QColor spaceColor;        // color of a dead cel;
     QColor gridColor;         // color of a grid
+    QColor majorGridColor;    // color of every majorGridInterval-th line
+    bool heatmap;             // cells are shown by the density of population
     
-    QBrush cellBrush;         // brush used to paint cells(plain, cellColor)
+    Rasterizer rasterizer;    // draws the cells of every frame
 
-    QPen gridPen;             // pen for drawing grid (has gridColor)
+    // the lines of majorGridInterval x majorGridInterval cells, tiled over
+    // the widget at a whole number of pixels per cell; made again when
+    // the cell width or a color changes
+    QBrush gridBrush;
+    int gridBrushCellWidth;   // what gridBrush is made for; 0 - nothing yet
 
-    // field increases in size (mouseScrollSensitivity) times after each scroll
+    // every this many cells, counted from cell 0, a line is drawn in
+    // majorGridColor
+    static const int majorGridInterval = 10;
+    // the grid is drawn over cells wider than this many pixels
+    static const int minGridCellWidth = 3;
+    // the widest gridBrush; bigger cells have their lines drawn one by one
+    static const int maxGridBrushSize = 1024;
+
+    // field increases in size (mouseScrollSensitivity) times after each
+    // step of the wheel
     double mouseScrollSensitivity;
 
-    // The entire field is being drawn between this two points
-    QPoint topLeftDrawingPosition;
-    QPoint bottomRightDrawingPosition;
+    // the part of the field on the screen and its scale
+    Viewport viewport;
 
     // position of a mouse; we need to store it to draw/move
     QPoint mousePosition;
 
     MOUSE_MODE mode; // how we process mouse events
 
-    // If the grid chaged its size after updating, then two drawing points
-    // change their positions so that the cell remains the same size and the
-    // same position
-    void preventResizing(int prevGridWidth,
-                         int currentGridWidth,
-                         int prevFieldWidth);
+    // A file is read into fileGrid, or written from it, on another thread
+    // while fileWatcher waits for it; that thread does not touch grid
+    Grid fileGrid;
+    FileProgress fileProgress;
+    QFutureWatcher<bool> fileWatcher;
+    bool fileBusy;            // true until fileFinished is emitted
+    bool fileLoading;         // true if the file is being read
+    QString fileName;
+
+    static bool loadFile(Grid *grid,
+                         FILE_FORMAT format,
+                         const QString &fileName,
+                         FileProgress *progress);
+    static bool saveFile(const Grid *grid,
+                         FILE_FORMAT format,
+                         const QString &fileName,
+                         FileProgress *progress);
+
+    // after the field has changed from "before", paints again only the
+    // part of the widget that shows the change
+    void updateChanges(const shared_ptr<const TreeNode> &before);
+
+    // the cell under the mouse
+    qint64 mouseCellX();
+    qint64 mouseCellY();
+
+    // true if a pattern can be put under the mouse
+    bool mouseInReach();
+
+    // draws the grid over the widget at the scale of the viewport
+    void drawGrid(QPainter *painter);
+
+    // draws the lines "spacing" pixels apart that go through "origin",
+    // over a rectangle of "size" from (0, 0)
+    static void drawGridLines(QPainter *painter,
+                              const QPoint &origin,
+                              const QSize &size,
+                              int spacing,
+                              const QColor &color);
+
+    // draws the lines of the viewport before every "interval"-th column
+    // and row, counted from cell 0, at any scale
+    void drawViewportLines(QPainter *painter,
+                           int interval,
+                           const QColor &color);
 
 public:
     GridPainter(QWidget *parent);
+    // cancels the file being read or written and waits for its thread
+    ~GridPainter();
 
     void setCellColor(QColor cc);
     void setSpaceColor(QColor sc);
     void setGridColor(QColor gc);
+    // the colors of the sparsest and the densest places of the heatmap
+    void setHeatmapColors(QColor sparse, QColor dense);
 
-    int getGenerationCount();
+    long long getGenerationCount();
     long getPopulation();
 
+    // speed of the simulation in generations per second; 0 means as fast as
+    // the frame budget allows
+    void setTargetRate(double generationsPerSecond);
+    double getTargetRate();
+
+    // milliseconds every frame may spend on computing generations
+    void setFrameBudget(int milliseconds);
+    int getFrameBudget();
+
+    // generations per second actually computed, and the step size used
+    double getAchievedRate();
+    int getStepLog2();
+
+    // the part of a big step done so far, if it takes more than a frame
+    double getStepProgress();
+
     // creates a square grid, whose side  = (width > height) ? width : height
     void initEmptyGrid(int width, int height);
 
     // fills a rectangle (width, height) with random cells
     void initRandom(int width, int height);
 
-    // Does its best to fit the entire field in the screen. If the field cannot
-    // fit entirely into the screen, even when the size of a cell is 1, then
-    // left-top part will be in the screen
+    // the field, to be looked at; it is replaced when a file is loaded
+    const Grid &getGrid();
+
+    // the part of the field that is on the screen, the whole field being
+    // [0, 1] x [0, 1]
+    QRectF getViewport();
+
+    // moves the field so that its point "point" ([0, 1] x [0, 1], as in
+    // getViewport) is in the centre of the widget
+    void centerOn(const QPointF &point);
+
+    // Fits the living cells into the screen, at a whole number of pixels
+    // per cell, or a power of two cells per pixel, so that cells line up
+    // with pixels; an empty field is fitted whole
     void autoFitDrawingPoints();
 
-    // Reads file "fileName", clears all the cells, and fills them according to
-    // the contents of that file
-    bool parsePlainText(const QString &fileName);
-    bool parseRLE(const QString &fileName);
+    // Start reading file "fileName" into a new field, or writing the
+    // current one into it, on another thread; the field can be used and
+    // run meanwhile. A field read replaces the current one when it is
+    // ready. fileFinished is emitted at the end. They return false if
+    // another file is being read or written
+    bool startLoading(FILE_FORMAT format, const QString &fileName);
+    bool startSaving(FILE_FORMAT format, const QString &fileName);
+
+    // true between startLoading or startSaving and fileFinished
+    bool isBusyWithFile();
 
-    // Writes current field into file "fileName"
-    void saveAsPlainText(const QString &fileName);
-    void saveAsRLE(const QString &fileName);
+    // the part of the file read or written so far, from 0 to 1, or -1 if
+    // it is not known
+    double getFileProgress();
+
+    // Opens a snapshot whose nodes are read only when they are needed
+    bool openPaged(const QString &fileName);
 
     void setMouseMode(MOUSE_MODE m);
 
@@ -114,7 +225,28 @@ public:
 
     int getHashSize();
 
+    // the engine counters since the start, so that the properties window
+    // needs nothing but the painter; the lists hold a number per level
+    long long getCounter(EngineStats::Counter counter);
+    long long getNodesAlive();
+    long long getNodesCreated();
+    QVector<long long> getNodesAlivePerLevel();
+    QVector<long long> getNodesCreatedPerLevel();
+    long long getBytesInUse();
+
+signals:
+    // success is false if the file could not be read or written, or if it
+    // was cancelled
+    void fileFinished(bool loading, bool success, const QString &fileName);
+
+    // the field could not be advanced, as it would grow beyond
+    // 2^Grid::maxLevel cells; a running field is stopped
+    void limitReached();
+
 public slots:
+    // the file stops being read or written soon, and nothing is changed
+    void cancelFile();
+
     void animate();
     void stopPressed();
     void clear();
@@ -122,8 +254,16 @@ public slots:
     void rotateAntiClockwise();
     void nextGeneration();
 
+    // shows the density of population instead of the cells
+    void setHeatmap(bool on);
+
+private slots:
+    void fileDone();
+    void finishFile(bool success);
+
 protected:
     void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
 #ifndef QT_NO_WHEELEVENT
     void wheelEvent(QWheelEvent *event) Q_DECL_OVERRIDE;
 #endif
@@ -0,0 +1,603 @@
+/* KPCC
+ * Command-line runner: loads a pattern, runs it and prints statistics as
+ * JSON; with --verify, checks the engine against a reference simulator
+ * instead. Needs neither widgets nor a display
+ * File: headless.cpp
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include "enginestats.h"
+#include "grid.h"
+#include "nodepager.h"
+#include "referencelife.h"
+#include "tracer.h"
+#include "treenode.h"
+
+// loads "fileName" into "grid", choosing the format by the extension
+static bool loadPattern(Grid &grid, const QString &fileName)
+{
+    if (!QFile::exists(fileName))
+    {
+        return false;
+    }
+    if (fileName.endsWith(".rle", Qt::CaseInsensitive))
+    {
+        return grid.parseRLE(fileName);
+    }
+    if (fileName.endsWith(".mc", Qt::CaseInsensitive))
+    {
+        return grid.parseMacrocell(fileName);
+    }
+    if (fileName.endsWith(".gsnap", Qt::CaseInsensitive))
+    {
+        return grid.parseSnapshot(fileName);
+    }
+    return grid.parsePlainText(fileName);
+}
+
+// saves "grid" to "fileName", choosing the format by the extension
+static bool savePattern(Grid &grid, const QString &fileName)
+{
+    if (fileName.endsWith(".mc", Qt::CaseInsensitive))
+    {
+        return grid.saveAsMacrocell(fileName);
+    }
+    if (fileName.endsWith(".gsnap", Qt::CaseInsensitive))
+    {
+        return grid.saveAsSnapshot(fileName);
+    }
+    if (fileName.endsWith(".rle", Qt::CaseInsensitive))
+    {
+        return grid.saveAsRLE(fileName);
+    }
+    return grid.saveAsPlainText(fileName);
+}
+
+// small patterns that exercise the border logic of Grid: fast movers,
+// cells far from each other, growth in all directions; consecutive
+// entries with the same name make up one pattern
+struct CuratedPattern
+{
+    const char *name;
+    const char *rows; // '*' - alive, '.' - dead, '/' ends a row
+    int x;            // where the top left corner is put
+    int y;
+};
+
+static const CuratedPattern curatedPatterns[] = {
+    {"blinker", "***", -1, 0},
+    {"glider", ".*./..*/***", 0, 0},
+    {"lwss", ".*..*/*..../*...*/****.", -2, -2},
+    {"rpentomino", ".**/**./.*.", -1, -1},
+    {"acorn", ".*...../...*.../**..***", -3, -1},
+    {"diehard", "......*./**....../.*...***", -4, -1},
+    {"gliders apart", ".*./..*/***", -60, -60},
+    {"gliders apart", ".*./..*/***", 60, 60},
+    {"block on the edge", "**/**", 39, 39},
+    {"block on the edge", "**/**", -41, -41},
+};
+
+static QVector<QPoint> parseRows(const char *rows, int x0, int y0)
+{
+    QVector<QPoint> cells;
+    int x = x0;
+    int y = y0;
+    for (const char *c = rows; *c != 0; c++)
+    {
+        if (*c == '/')
+        {
+            x = x0;
+            y++;
+            continue;
+        }
+        if (*c == '*')
+        {
+            cells.push_back(QPoint(x, y));
+        }
+        x++;
+    }
+    return cells;
+}
+
+// the living cells of "grid"; x is the width index, y - the height index
+static QVector<QPoint> livingCells(const Grid &grid)
+{
+    QVector<QPoint> cells;
+    if (grid.isEmpty())
+    {
+        return cells;
+    }
+    int half = grid.getWidth() / 2;
+    for (int y = grid.topBoundary(); y <= grid.bottomBoundary(); y++)
+    {
+        for (int x = grid.leftBoundary(); x <= grid.rightBoundary(); x++)
+        {
+            if (grid.isAlive(y - half, x - half))
+            {
+                cells.push_back(QPoint(x - half, y - half));
+            }
+        }
+    }
+    return cells;
+}
+
+static bool sameCells(const Grid &grid, const ReferenceLife &reference)
+{
+    if (grid.getPopulation() != reference.getPopulation())
+    {
+        return false;
+    }
+    // as many cells as the reference, so alive in the reference is enough
+    foreach (const QPoint &cell, reference.livingCells())
+    {
+        if (!grid.isAlive(cell.y(), cell.x()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Mismatch
+{
+    long long generation; // the first generation that differs
+    QString kind;         // how Grid got there
+};
+
+/**
+*   Runs "cells" for "generations" generations through Grid::update and the
+*   reference in lockstep, then once more with steps of 2, 4, 8, ...
+*   generations through Grid::step. Returns true and fills "mismatch" if
+*   Grid and the reference ever disagree. If "faultGeneration" is not -1,
+*   cell (0, 0) of the reference is flipped after that generation, so that
+*   the harness itself can be checked.
+*/
+static bool findMismatch(const QVector<QPoint> &cells, long long generations,
+                         Mismatch &mismatch, long long faultGeneration = -1)
+{
+    Grid grid;
+    ReferenceLife reference;
+    foreach (const QPoint &cell, cells)
+    {
+        grid.setAlive(cell.y(), cell.x(), true);
+        reference.setAlive(cell.x(), cell.y(), true);
+    }
+    Grid jumping = grid;
+    ReferenceLife jumpingReference = reference;
+
+    for (long long g = 1; g <= generations; g++)
+    {
+        grid.update();
+        reference.update();
+        if (g == faultGeneration)
+        {
+            reference.setAlive(0, 0, !reference.isAlive(0, 0));
+        }
+        if (!sameCells(grid, reference))
+        {
+            mismatch.generation = g;
+            mismatch.kind = "update";
+            return true;
+        }
+    }
+
+    for (int k = 1; k <= TreeNode::maxStepLog2 &&
+                    jumping.getGeneration() + (1LL << k) <= generations; k++)
+    {
+        jumping.step(k);
+        for (long long i = 0; i < (1LL << k); i++)
+        {
+            jumpingReference.update();
+        }
+        if (!sameCells(jumping, jumpingReference))
+        {
+            mismatch.generation = jumping.getGeneration();
+            mismatch.kind = QString("step(%1)").arg(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+*   Removes cells from a failing pattern while it still fails, first in big
+*   chunks, then one by one (delta debugging), so that the reproducer is
+*   small. Only the generations up to the mismatch are run.
+*/
+static QVector<QPoint> minimize(QVector<QPoint> cells, Mismatch &mismatch)
+{
+    int chunk = max(cells.size() / 2, 1);
+    while (true)
+    {
+        bool removed = false;
+        for (int start = 0; start < cells.size(); )
+        {
+            QVector<QPoint> smaller = cells.mid(0, start) +
+                                      cells.mid(start + chunk);
+            Mismatch smallerMismatch;
+            if (!smaller.isEmpty() &&
+                findMismatch(smaller, mismatch.generation, smallerMismatch))
+            {
+                cells = smaller;
+                mismatch = smallerMismatch;
+                removed = true;
+            }
+            else
+            {
+                start += chunk;
+            }
+        }
+        if (chunk == 1 && !removed)
+        {
+            return cells;
+        }
+        if (!removed)
+        {
+            chunk = max(chunk / 2, 1);
+        }
+    }
+}
+
+// "cells" in RLE, with the top left living cell at (0, 0)
+static QString toRLE(const QVector<QPoint> &cells)
+{
+    ReferenceLife field;
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+    for (int i = 0; i < cells.size(); i++)
+    {
+        const QPoint &cell = cells[i];
+        left = i == 0 ? cell.x() : min(left, cell.x());
+        top = i == 0 ? cell.y() : min(top, cell.y());
+        right = i == 0 ? cell.x() : max(right, cell.x());
+        bottom = i == 0 ? cell.y() : max(bottom, cell.y());
+        field.setAlive(cell.x(), cell.y(), true);
+    }
+    QString rle = QString("x = %1, y = %2, rule = B3/S23\n")
+                      .arg(cells.isEmpty() ? 0 : right - left + 1)
+                      .arg(cells.isEmpty() ? 0 : bottom - top + 1);
+    for (int y = top; y <= bottom && !cells.isEmpty(); y++)
+    {
+        for (int x = left; x <= right; )
+        {
+            bool alive = field.isAlive(x, y);
+            int run = 0;
+            while (x <= right && field.isAlive(x, y) == alive)
+            {
+                x++;
+                run++;
+            }
+            if (!alive && x > right)
+            {
+                break; // dead cells at the end of a row are not written
+            }
+            if (run > 1)
+            {
+                rle += QString::number(run);
+            }
+            rle += alive ? "o" : "b";
+        }
+        rle += y < bottom ? "$" : "";
+    }
+    return rle + "!";
+}
+
+// checks one pattern; the result says whether it passed, and if not,
+// holds a minimized reproducer
+static QJsonObject verifyPattern(const QString &name,
+                                 const QVector<QPoint> &cells,
+                                 long long generations)
+{
+    QJsonObject result;
+    result["name"] = name;
+    result["cells"] = cells.size();
+    Mismatch mismatch;
+    if (!findMismatch(cells, generations, mismatch))
+    {
+        result["passed"] = true;
+        return result;
+    }
+    result["passed"] = false;
+    result["generation"] = (double)mismatch.generation;
+    result["kind"] = mismatch.kind;
+    QVector<QPoint> reproducer = minimize(cells, mismatch);
+    QJsonObject minimized;
+    QJsonArray points;
+    foreach (const QPoint &cell, reproducer)
+    {
+        QJsonArray point;
+        point.append(cell.x());
+        point.append(cell.y());
+        points.append(point);
+    }
+    minimized["cells"] = points;
+    minimized["generation"] = (double)mismatch.generation;
+    minimized["kind"] = mismatch.kind;
+    minimized["rle"] = toRLE(reproducer);
+    result["reproducer"] = minimized;
+    return result;
+}
+
+// writes the trace if tracing was asked for
+static bool writeTrace(const QString &fileName)
+{
+    if (fileName.isEmpty() || Tracer::exportChromeTrace(fileName))
+    {
+        return true;
+    }
+    QTextStream(stderr) << "Could not write " << fileName << "\n";
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("gemini-headless");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs a Life pattern without a GUI and "
+                                     "prints statistics as JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("file", "Pattern (.rle, .mc, .gsnap or "
+                                 "plain text); with --verify, any number of "
+                                 "them.");
+    QCommandLineOption generationsOption(QStringList() << "g"
+                                                       << "generations",
+                                         "Advance <n> generations.",
+                                         "n",
+                                         "0");
+    QCommandLineOption stepOption(QStringList() << "k" << "step",
+                                  "Advance in steps of 2^<k> generations "
+                                  "(see --steps).",
+                                  "k");
+    QCommandLineOption stepsOption(QStringList() << "s" << "steps",
+                                   "Number of 2^k steps to make.",
+                                   "count",
+                                   "1");
+    QCommandLineOption verifyOption(QStringList() << "verify",
+                                    "Compare the engine with a reference "
+                                    "simulator on the files, the built-in "
+                                    "patterns and random soups for <n> "
+                                    "generations (200 if not set) and "
+                                    "print minimized reproducers of "
+                                    "failures.");
+    QCommandLineOption randomOption(QStringList() << "random",
+                                    "With --verify, the number of random "
+                                    "soups.",
+                                    "count",
+                                    "20");
+    QCommandLineOption sizeOption(QStringList() << "size",
+                                  "With --verify, the side of a soup.",
+                                  "n",
+                                  "16");
+    QCommandLineOption seedOption(QStringList() << "seed",
+                                  "With --verify, the random seed.",
+                                  "n",
+                                  "2016");
+    parser.addOption(generationsOption);
+    parser.addOption(stepOption);
+    parser.addOption(stepsOption);
+    parser.addOption(verifyOption);
+    parser.addOption(randomOption);
+    parser.addOption(sizeOption);
+    QCommandLineOption saveOption(QStringList() << "o" << "output",
+                                  "Save the field to <file> after the run "
+                                  "(.mc - macrocell, .gsnap - snapshot, "
+                                  ".rle, or plain text).",
+                                  "file");
+    QCommandLineOption traceOption(QStringList() << "trace",
+                                   "Write a Chrome trace of the run to "
+                                   "<file>.",
+                                   "file");
+    QCommandLineOption pagedOption(QStringList() << "paged",
+                                   "Open the .gsnap snapshot without "
+                                   "reading it; nodes are read from the file "
+                                   "when needed.");
+    QCommandLineOption pageBudgetOption(QStringList() << "page-budget",
+                                        "With --paged, keep the children of "
+                                        "at most <n> nodes read.",
+                                        "n",
+                                        QString::number(
+                                            NodePager::defaultBudget));
+    parser.addOption(seedOption);
+    parser.addOption(saveOption);
+    parser.addOption(traceOption);
+    parser.addOption(pagedOption);
+    parser.addOption(pageBudgetOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    Tracer::setEnabled(parser.isSet(traceOption));
+
+    if (parser.isSet(verifyOption))
+    {
+        long long generations = parser.isSet(generationsOption) ?
+                    parser.value(generationsOption).toLongLong() : 200;
+        QVector<QString> names;
+        QVector<QVector<QPoint> > patterns;
+        foreach (const QString &fileName, parser.positionalArguments())
+        {
+            Grid grid;
+            if (!loadPattern(grid, fileName))
+            {
+                err << "Could not load " << fileName << "\n";
+                return 1;
+            }
+            QVector<QPoint> cells = livingCells(grid);
+            if (cells.size() != grid.getPopulation())
+            {
+                err << "Read " << cells.size() << " of "
+                    << grid.getPopulation() << " living cells of "
+                    << fileName << "\n";
+                return 1;
+            }
+            names.push_back(fileName);
+            patterns.push_back(cells);
+        }
+        for (const CuratedPattern &curated : curatedPatterns)
+        {
+            if (names.isEmpty() || names.last() != curated.name)
+            {
+                names.push_back(curated.name);
+                patterns.push_back(QVector<QPoint>());
+            }
+            patterns.last() += parseRows(curated.rows, curated.x, curated.y);
+        }
+        qsrand(parser.value(seedOption).toUInt());
+        int size = max(parser.value(sizeOption).toInt(), 1);
+        int soups = parser.value(randomOption).toInt();
+        for (int i = 0; i < soups; i++)
+        {
+            QVector<QPoint> soup;
+            for (int y = -size / 2; y < size - size / 2; y++)
+            {
+                for (int x = -size / 2; x < size - size / 2; x++)
+                {
+                    if (qrand() % 8 < 3)
+                    {
+                        soup.push_back(QPoint(x, y));
+                    }
+                }
+            }
+            names.push_back(QString("soup %1").arg(i));
+            patterns.push_back(soup);
+        }
+
+        // a case that has to fail: a glider whose reference is broken on
+        // purpose. A harness that misses it would pass anything
+        Mismatch injected;
+        if (!findMismatch(parseRows(".*/..*/***", 0, 0), max(generations, 1LL),
+                          injected, 1))
+        {
+            err << "The harness missed a mismatch made on purpose\n";
+            return 1;
+        }
+
+        QJsonArray results;
+        int failures = 0;
+        for (int i = 0; i < patterns.size(); i++)
+        {
+            err << "Verifying " << names[i] << "...\n";
+            err.flush();
+            QJsonObject result = verifyPattern(names[i], patterns[i],
+                                               generations);
+            failures += result["passed"].toBool() ? 0 : 1;
+            results.append(result);
+        }
+        QJsonObject report;
+        report["generations"] = (double)generations;
+        report["patterns"] = patterns.size();
+        report["failures"] = failures;
+        report["results"] = results;
+        out << QJsonDocument(report).toJson();
+        if (!writeTrace(parser.value(traceOption)))
+        {
+            return 1;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    if (parser.positionalArguments().size() != 1)
+    {
+        parser.showHelp(1);
+    }
+    QString fileName = parser.positionalArguments().first();
+
+    Grid grid;
+    QElapsedTimer clock;
+    clock.start();
+    bool loaded = parser.isSet(pagedOption) ? grid.openPaged(fileName)
+                                            : loadPattern(grid, fileName);
+    if (!loaded)
+    {
+        err << "Could not load " << fileName << "\n";
+        return 1;
+    }
+    grid.setPageBudget(parser.value(pageBudgetOption).toInt());
+    qint64 loadTime = clock.nsecsElapsed();
+    // snapshots and macrocells may start at a later generation
+    long long firstGeneration = grid.getGeneration();
+
+    // the counters describe the run only
+    EngineStats::reset();
+    clock.start();
+    if (parser.isSet(stepOption))
+    {
+        int k = parser.value(stepOption).toInt();
+        long long steps = parser.value(stepsOption).toLongLong();
+        if (k < 0 || k > TreeNode::maxStepLog2)
+        {
+            err << "The step must be from 0 to " << TreeNode::maxStepLog2
+                << "\n";
+            return 1;
+        }
+        for (long long i = 0; i < steps; i++)
+        {
+            if (!grid.step(k))
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        grid.advance(parser.value(generationsOption).toLongLong());
+    }
+    qint64 runTime = clock.nsecsElapsed();
+    if (grid.isAtLimit())
+    {
+        // what was computed is still saved and reported
+        err << "The field would grow beyond 2^" << Grid::maxLevel
+            << " cells; stopped at generation " << grid.getGeneration()
+            << "\n";
+    }
+
+    if (parser.isSet(saveOption))
+    {
+        QString saveName = parser.value(saveOption);
+        if (!savePattern(grid, saveName))
+        {
+            err << "Could not write " << saveName << "\n";
+            return 1;
+        }
+    }
+
+    QJsonObject result;
+    result["file"] = fileName;
+    result["generation"] = (double)grid.getGeneration();
+    result["population"] = (double)grid.getPopulation();
+    if (grid.getPopulation() > 0)
+    {
+        // the centre of the field is (0, 0)
+        int half = grid.getWidth() / 2;
+        QJsonObject box;
+        box["left"] = grid.leftBoundary() - half;
+        box["top"] = grid.topBoundary() - half;
+        box["right"] = grid.rightBoundary() - half;
+        box["bottom"] = grid.bottomBoundary() - half;
+        result["boundingBox"] = box;
+    }
+    QJsonObject time;
+    time["loadMs"] = loadTime / 1e6;
+    time["runMs"] = runTime / 1e6;
+    long long generationsRun = grid.getGeneration() - firstGeneration;
+    time["generations"] = (double)generationsRun;
+    time["generationsPerSecond"] = runTime > 0 ?
+                                       generationsRun * 1e9 / runTime : 0;
+    result["time"] = time;
+    result["stats"] = EngineStats::toJson();
+
+    out << QJsonDocument(result).toJson();
+    return writeTrace(parser.value(traceOption)) && !grid.isAtLimit() ? 0 : 1;
+}
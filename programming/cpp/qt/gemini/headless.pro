@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Command-line runner for batch jobs; links the static engine library
+# (build engine.pro first, or build all.pro)
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = gemini-headless
+TEMPLATE = app
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .obj/headless
+
+INCLUDEPATH += $$PWD
+
+LIBS += -L$$OUT_PWD -lgeminiengine
+PRE_TARGETDEPS += $$OUT_PWD/libgeminiengine.a
+
+SOURCES += headless.cpp \
+    referencelife.cpp
+
+HEADERS += referencelife.h
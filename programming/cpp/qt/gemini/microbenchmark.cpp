@@ -0,0 +1,362 @@
+/* KPCC
+ * Microbenchmarks of TreeNode primitives across tree levels and fill
+ * densities; prints nanoseconds and allocated nodes per operation as JSON
+ * File: microbenchmark.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QVector>
+
+#include "enginestats.h"
+#include "treenode.h"
+
+// the primitives below are private to TreeNode; this class is its friend
+class TreeNodeBenchmark
+{
+public:
+    static shared_ptr<TreeNode> centeredSubnode(shared_ptr<TreeNode> n)
+    {
+        return n->centeredSubnode();
+    }
+
+    static shared_ptr<TreeNode> centeredHorizontal(shared_ptr<TreeNode> n)
+    {
+        return n->centeredHorizontal(n->nw(), n->ne());
+    }
+
+    static shared_ptr<TreeNode> centeredVertical(shared_ptr<TreeNode> n)
+    {
+        return n->centeredVertical(n->nw(), n->sw());
+    }
+
+    static shared_ptr<TreeNode> slowSimulation(shared_ptr<TreeNode> n)
+    {
+        return n->slowSimulation();
+    }
+
+    static void memoize(shared_ptr<TreeNode> n)
+    {
+        TreeNode::hashMap[0][n] = n;
+    }
+
+    static shared_ptr<TreeNode> memoLookup(shared_ptr<TreeNode> n)
+    {
+        return TreeNode::hashMap[0].value(n, nullptr);
+    }
+};
+
+// results are accumulated here, so that the compiler can not throw the
+// measured operations away
+static volatile long sink;
+
+struct Statistics
+{
+    double median;   // nanoseconds per operation
+    double mad;      // median absolute deviation of that
+    double min;
+    double mean;
+    double stddev;
+    double allocations; // nodes created per operation
+    long long batch;    // operations per repetition
+};
+
+static double medianOf(QVector<double> values)
+{
+    sort(values.begin(), values.end());
+    int n = values.size();
+    return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+/**
+*   Runs op(0), op(1), ... in batches. The batch size is doubled until a
+*   batch takes batchNs, which also warms up the caches; then "repetitions"
+*   batches are timed, and their spread is reported along with the median.
+*/
+template<class Op>
+static Statistics measure(Op op, int repetitions, qint64 batchNs)
+{
+    Statistics stats;
+    long long batch = 1;
+    QElapsedTimer clock;
+    while (true)
+    {
+        clock.start();
+        for (long long i = 0; i < batch; i++)
+        {
+            op(i);
+        }
+        if (clock.nsecsElapsed() >= batchNs || batch >= (1LL << 40))
+        {
+            break;
+        }
+        batch *= 2;
+    }
+
+    QVector<double> times;
+    double allocations = 0;
+    for (int r = 0; r < repetitions; r++)
+    {
+        long long nodes = EngineStats::getNodesCreated();
+        clock.start();
+        for (long long i = 0; i < batch; i++)
+        {
+            op(i);
+        }
+        times.push_back((double)clock.nsecsElapsed() / batch);
+        allocations += (double)(EngineStats::getNodesCreated() - nodes) / batch;
+    }
+
+    stats.batch = batch;
+    stats.median = medianOf(times);
+    QVector<double> deviations;
+    double sum = 0;
+    for (int r = 0; r < times.size(); r++)
+    {
+        deviations.push_back(fabs(times[r] - stats.median));
+        sum += times[r];
+    }
+    stats.mad = medianOf(deviations);
+    stats.min = *min_element(times.begin(), times.end());
+    stats.mean = sum / times.size();
+    double squares = 0;
+    for (int r = 0; r < times.size(); r++)
+    {
+        squares += (times[r] - stats.mean) * (times[r] - stats.mean);
+    }
+    stats.stddev = times.size() > 1 ? sqrt(squares / (times.size() - 1)) : 0;
+    stats.allocations = allocations / repetitions;
+    return stats;
+}
+
+// a node of the given level with about "density" of its cells alive;
+// above level 8 it is made of four copies of one random node, as big
+// patterns in HashLife are
+static shared_ptr<TreeNode> randomNode(int level, double density)
+{
+    shared_ptr<TreeNode> node = TreeNode().emptyTree(level);
+    if (level > 8)
+    {
+        shared_ptr<TreeNode> child = randomNode(level - 1, density);
+        return make_shared<TreeNode>(child, child, child, child);
+    }
+    int half = (1 << level) / 2;
+    for (int y = -half; y < half; y++)
+    {
+        for (int x = -half; x < half; x++)
+        {
+            if (qrand() < density * RAND_MAX)
+            {
+                node = node->setBit(x, y);
+            }
+        }
+    }
+    return node;
+}
+
+// the same tree, rebuilt from new nodes, so that == has to compare it all;
+// nodes shared in the original are shared in the copy too
+static shared_ptr<TreeNode> deepCopy(shared_ptr<TreeNode> node,
+                                     QHash<TreeNode *, shared_ptr<TreeNode>>
+                                         &copies)
+{
+    shared_ptr<TreeNode> copy = copies.value(node.get(), nullptr);
+    if (copy != nullptr)
+    {
+        return copy;
+    }
+    if (node->getLevel() == 0)
+    {
+        copy = make_shared<TreeNode>(node->isAlive());
+    }
+    else
+    {
+        copy = make_shared<TreeNode>(deepCopy(node->getnw(), copies),
+                                     deepCopy(node->getne(), copies),
+                                     deepCopy(node->getsw(), copies),
+                                     deepCopy(node->getse(), copies));
+    }
+    copies[node.get()] = copy;
+    return copy;
+}
+
+struct Case
+{
+    QString name;
+    int level;
+    double density;
+    function<Statistics()> run;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("gemini-microbenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures TreeNode primitives and prints "
+                                     "nanoseconds and nodes allocated per "
+                                     "operation as JSON.");
+    parser.addHelpOption();
+    QCommandLineOption repetitionsOption(QStringList() << "r"
+                                                       << "repetitions",
+                                         "Timed batches per case.",
+                                         "n",
+                                         "15");
+    QCommandLineOption batchOption(QStringList() << "b" << "batch",
+                                   "Minimal time of a batch, microseconds.",
+                                   "us",
+                                   "10000");
+    QCommandLineOption onlyOption(QStringList() << "only",
+                                  "Run only the primitive <name> "
+                                  "(can be repeated).",
+                                  "name");
+    parser.addOption(repetitionsOption);
+    parser.addOption(batchOption);
+    parser.addOption(onlyOption);
+    parser.process(app);
+
+    int repetitions = max(parser.value(repetitionsOption).toInt(), 1);
+    qint64 batchNs = max(parser.value(batchOption).toLongLong(), 1LL) * 1000;
+    QStringList only = parser.values(onlyOption);
+
+    qsrand(2016);
+    // random coordinates, so that every operation touches another cell
+    const int coordinateCount = 1024;
+    QVector<int> xs(coordinateCount);
+    QVector<int> ys(coordinateCount);
+    for (int i = 0; i < coordinateCount; i++)
+    {
+        xs[i] = qrand();
+        ys[i] = qrand();
+    }
+
+    QVector<Case> cases;
+    const int levels[] = {3, 6, 9, 12};
+    const double densities[] = {0.1, 0.5, 0.9};
+    for (int level : levels)
+    {
+        for (double density : densities)
+        {
+            shared_ptr<TreeNode> node = randomNode(level, density);
+            QHash<TreeNode *, shared_ptr<TreeNode>> copies;
+            shared_ptr<TreeNode> copy = deepCopy(node, copies);
+            int size = 1 << level;
+            int half = size / 2;
+            cases.push_back({"setBit", level, density, [=]() {
+                return measure([=](long long i) {
+                    int k = i % coordinateCount;
+                    sink += node->setBit(xs[k] % size - half,
+                                         ys[k] % size - half)->getLevel();
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"getBit", level, density, [=]() {
+                return measure([=](long long i) {
+                    int k = i % coordinateCount;
+                    sink += node->getBit(xs[k] % size - half,
+                                         ys[k] % size - half);
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"expandUniverse", level, density, [=]() {
+                return measure([=](long long) {
+                    sink += node->expandUniverse()->getLevel();
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"centeredSubnode", level, density, [=]() {
+                return measure([=](long long) {
+                    sink += TreeNodeBenchmark::centeredSubnode(node)
+                                ->getLevel();
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"centeredHorizontal", level, density, [=]() {
+                return measure([=](long long) {
+                    sink += TreeNodeBenchmark::centeredHorizontal(node)
+                                ->getLevel();
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"centeredVertical", level, density, [=]() {
+                return measure([=](long long) {
+                    sink += TreeNodeBenchmark::centeredVertical(node)
+                                ->getLevel();
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"memoHit", level, density, [=]() {
+                TreeNode::clearHash();
+                TreeNodeBenchmark::memoize(node);
+                return measure([=](long long) {
+                    sink += TreeNodeBenchmark::memoLookup(copy) != nullptr;
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"memoMiss", level, density, [=]() {
+                TreeNode::clearHash();
+                return measure([=](long long) {
+                    sink += TreeNodeBenchmark::memoLookup(copy) != nullptr;
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"equalSame", level, density, [=]() {
+                return measure([=](long long) {
+                    sink += node == node;
+                }, repetitions, batchNs);
+            }});
+            cases.push_back({"equalCopy", level, density, [=]() {
+                return measure([=](long long) {
+                    sink += node == copy;
+                }, repetitions, batchNs);
+            }});
+        }
+    }
+    // slowSimulation works on 4x4 nodes only
+    for (double density : densities)
+    {
+        shared_ptr<TreeNode> node = randomNode(2, density);
+        cases.push_back({"slowSimulation", 2, density, [=]() {
+            return measure([=](long long) {
+                sink += TreeNodeBenchmark::slowSimulation(node)
+                            ->getPopulation();
+            }, repetitions, batchNs);
+        }});
+    }
+
+    QTextStream err(stderr);
+    QJsonArray results;
+    foreach (const Case &c, cases)
+    {
+        if (!only.isEmpty() && !only.contains(c.name))
+        {
+            continue;
+        }
+        err << c.name << " level " << c.level << " density " << c.density
+            << "\n";
+        err.flush();
+        Statistics stats = c.run();
+        QJsonObject result;
+        result["name"] = c.name;
+        result["level"] = c.level;
+        result["density"] = c.density;
+        result["nsPerOp"] = stats.median;
+        result["madNs"] = stats.mad;
+        result["minNs"] = stats.min;
+        result["meanNs"] = stats.mean;
+        result["stddevNs"] = stats.stddev;
+        result["allocationsPerOp"] = stats.allocations;
+        result["batch"] = (double)stats.batch;
+        results.append(result);
+    }
+    TreeNode::clearHash();
+
+    QJsonObject report;
+    report["qtVersion"] = QString(qVersion());
+    report["repetitions"] = repetitions;
+    report["results"] = results;
+    QTextStream(stdout) << QJsonDocument(report).toJson();
+    return 0;
+}
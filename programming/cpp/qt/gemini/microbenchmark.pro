@@ -0,0 +1,23 @@
+#-------------------------------------------------
+#
+# Microbenchmarks of TreeNode primitives; links the static engine library
+# (build engine.pro first, or build all.pro)
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = gemini-microbenchmark
+TEMPLATE = app
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .obj/microbenchmark
+
+INCLUDEPATH += $$PWD
+
+LIBS += -L$$OUT_PWD -lgeminiengine
+PRE_TARGETDEPS += $$OUT_PWD/libgeminiengine.a
+
+SOURCES += microbenchmark.cpp
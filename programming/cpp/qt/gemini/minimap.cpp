@@ -0,0 +1,69 @@
+/* KPCC
+ * Minimap is a small view of the whole field
+ * File: minimap.cpp
+ */
+
+#include <QPainter>
+
+#include "minimap.h"
+#include "tracer.h"
+
+Minimap::Minimap(GridPainter *gridPainter, QWidget *parent) : QWidget(parent)
+{
+    this->gridPainter = gridPainter;
+    setFixedSize(side, side);
+    setCursor(Qt::PointingHandCursor);
+}
+
+void Minimap::paintEvent(QPaintEvent *event)
+{
+    TRACE_ZONE("Minimap::paintEvent");
+    Q_UNUSED(event);
+
+    // the field is square, so it fills the minimap
+    const Grid &grid = gridPainter->getGrid();
+    Viewport view;
+    view.setSize(size());
+    view.fit(-grid.getWidth() / 2, -grid.getWidth() / 2,
+             grid.getWidth(), grid.getWidth());
+    rasterizer.begin(size(), palette().color(QPalette::Base), rect());
+    grid.draw(&rasterizer, view, 0, 0, palette().color(QPalette::Text));
+
+    QPainter painter(this);
+    painter.drawImage(0, 0, rasterizer.getImage());
+
+    QRectF view = gridPainter->getViewport();
+    painter.setPen(palette().color(QPalette::Highlight));
+    painter.setBrush(Qt::NoBrush);
+    // at least a pixel big, so a deep zoom can still be seen
+    painter.drawRect(QRectF(view.x() * side,
+                            view.y() * side,
+                            qMax(view.width() * side - 1, 1.0),
+                            qMax(view.height() * side - 1, 1.0)));
+    painter.setPen(palette().color(QPalette::Mid));
+    painter.drawRect(0, 0, side - 1, side - 1);
+}
+
+void Minimap::jump(const QPoint &point)
+{
+    gridPainter->centerOn(QPointF((point.x() + 0.5) / side,
+                                  (point.y() + 0.5) / side));
+    update();
+}
+
+void Minimap::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        jump(event->pos());
+    }
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *event)
+{
+    // the view follows the mouse while the button is held
+    if (event->buttons() & Qt::LeftButton)
+    {
+        jump(event->pos());
+    }
+}
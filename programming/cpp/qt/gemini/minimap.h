@@ -0,0 +1,43 @@
+/* KPCC
+ * Minimap is a small view of the whole field next to the big one. It is
+ * drawn from node populations alone: a node a pixel wide is a pixel, lit
+ * if anything lives in it, so no cell is looked at and a frame takes
+ * about the same time however big the field is. The part of the field
+ * shown by the GridPainter is framed, and clicking moves it there
+ * File: minimap.h
+ */
+
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QWidget>
+
+#include "gridpainter.h"
+#include "rasterizer.h"
+
+class Minimap : public QWidget
+{
+    Q_OBJECT
+
+private:
+    GridPainter *gridPainter; // whose field is shown
+    Rasterizer rasterizer;    // of its own, so the tiles of both are kept
+
+    // moves the view of gridPainter to the point of the minimap
+    void jump(const QPoint &point);
+
+protected:
+    void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
+    void mousePressEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
+    void mouseMoveEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
+
+public:
+    Minimap(GridPainter *gridPainter, QWidget *parent = nullptr);
+
+    // the side of the minimap in pixels
+    static const int side = 160;
+};
+
+#endif // MINIMAP_H
@@ -0,0 +1,209 @@
+/* KPCC
+ * NodePager serves the nodes of a mapped snapshot on demand
+ * File: nodepager.cpp
+ */
+
+#include <cstring>
+
+#include "enginestats.h"
+#include "nodepager.h"
+
+QHash<const TreeNode *, NodePager::PagedNode> &NodePager::pagedNodes()
+{
+    static QHash<const TreeNode *, PagedNode> *nodes =
+        new QHash<const TreeNode *, PagedNode>();
+    return *nodes;
+}
+
+NodePager::NodePager()
+{
+    data = nullptr;
+    records = nullptr;
+    memset(&header, 0, sizeof(header));
+    clock = 0;
+    budget = defaultBudget;
+}
+
+NodePager::~NodePager()
+{
+    if (data != nullptr)
+    {
+        file.unmap((uchar *)data);
+    }
+}
+
+shared_ptr<NodePager> NodePager::open(const QString &fileName)
+{
+    shared_ptr<NodePager> pager(new NodePager());
+    pager->file.setFileName(fileName);
+    if (!pager->file.open(QIODevice::ReadOnly) ||
+        pager->file.size() < (qint64)sizeof(Snapshot::Header))
+    {
+        return nullptr;
+    }
+    // nodes are read in place, so the file has to be mapped
+    pager->data = pager->file.map(0, pager->file.size());
+    if (pager->data == nullptr)
+    {
+        return nullptr;
+    }
+    memcpy(&pager->header, pager->data, sizeof(Snapshot::Header));
+    if (!Snapshot::isValid(pager->header, pager->file.size()))
+    {
+        return nullptr;
+    }
+    pager->records = (const Snapshot::Record *)(pager->data +
+                                                sizeof(Snapshot::Header));
+    if (pager->header.version < 2)
+    {
+        pager->hashes = Snapshot::computeHashes(pager->records,
+                                                pager->header.nodeCount);
+    }
+    return pager;
+}
+
+shared_ptr<TreeNode> NodePager::root()
+{
+    return node(header.nodeCount, header.rootLevel);
+}
+
+long long NodePager::getGeneration() const
+{
+    return header.generation;
+}
+
+int NodePager::getStepLog2() const
+{
+    return header.stepLog2;
+}
+
+void NodePager::setBudget(int nodes)
+{
+    budget = max(nodes, 1);
+}
+
+int NodePager::getBudget() const
+{
+    return budget;
+}
+
+int NodePager::loadedCount() const
+{
+    return loadTime.size();
+}
+
+shared_ptr<TreeNode> NodePager::node(quint32 number, int level)
+{
+    if (number == 0)
+    {
+        return builder.emptyNode(level);
+    }
+    shared_ptr<TreeNode> existing = live.value(number).lock();
+    if (existing != nullptr)
+    {
+        return existing;
+    }
+    const Snapshot::Record &record = records[number - 1];
+    if ((int)record.level != level)
+    {
+        return builder.emptyNode(level); // a damaged record
+    }
+    quint32 hash = hashes.isEmpty() ? record.hash : hashes[number - 1];
+    shared_ptr<TreeNode> node(new TreeNode(record.level,
+                                           record.population,
+                                           hash));
+    PagedNode paged;
+    paged.pager = shared_from_this();
+    paged.record = number;
+    pagedNodes()[node.get()] = paged;
+    live[number] = node;
+    return node;
+}
+
+void NodePager::pageIn(const TreeNode *node)
+{
+    PagedNode paged = pagedNodes().value(node);
+    paged.pager->load(node, paged.record);
+}
+
+void NodePager::release(const TreeNode *node)
+{
+    // the pager may be destroyed with the last of its nodes, so the
+    // reference is held until it has forgotten this one
+    PagedNode paged = pagedNodes().take(node);
+    paged.pager->forget(node, paged.record);
+}
+
+/**
+*   The table was checked when the snapshot was saved, not when it was
+*   opened: checking it would mean reading all of it. A damaged record
+*   makes the pattern wrong, but nothing is read out of the file and the
+*   tree keeps its shape.
+*/
+void NodePager::load(const TreeNode *node, quint32 number)
+{
+    EngineStats::add(EngineStats::PageFaults);
+    const Snapshot::Record &record = records[number - 1];
+    if (node->level == 3)
+    {
+        shared_ptr<TreeNode> block = builder.blockNode(record.cells);
+        node->nwNode = block->nwNode;
+        node->neNode = block->neNode;
+        node->swNode = block->swNode;
+        node->seNode = block->seNode;
+    }
+    else
+    {
+        // children come before their parents in the table
+        quint32 children[4];
+        for (int i = 0; i < 4; i++)
+        {
+            children[i] = record.children[i] < number ? record.children[i]
+                                                       : 0;
+        }
+        node->nwNode = this->node(children[0], node->level - 1);
+        node->neNode = this->node(children[1], node->level - 1);
+        node->swNode = this->node(children[2], node->level - 1);
+        node->seNode = this->node(children[3], node->level - 1);
+    }
+    loadTime[node] = ++clock;
+    loadOrder[clock] = node;
+}
+
+void NodePager::forget(const TreeNode *node, quint32 number)
+{
+    if (live.contains(number) && live[number].expired())
+    {
+        live.remove(number);
+    }
+    if (loadTime.contains(node))
+    {
+        loadOrder.remove(loadTime.take(node));
+    }
+}
+
+/**
+*   The memo is cleared for all the trees, not only the paged one; freeing
+*   a quarter of the budget at a time keeps that from happening on every
+*   slice of a step.
+*/
+void NodePager::trim()
+{
+    if (loadTime.size() <= budget)
+    {
+        return;
+    }
+    while (loadTime.size() > budget - budget / 4)
+    {
+        const TreeNode *node = loadOrder.begin().value();
+        loadOrder.erase(loadOrder.begin());
+        loadTime.remove(node);
+        // the children are destroyed at the end of the iteration, if
+        // nothing else uses them, and then forget about themselves
+        shared_ptr<TreeNode> children[4] = {node->nwNode, node->neNode,
+                                            node->swNode, node->seNode};
+        node->nwNode = node->neNode = node->swNode = node->seNode = nullptr;
+        EngineStats::add(EngineStats::PageEvictions);
+    }
+    TreeNode::clearHash();
+}
@@ -0,0 +1,111 @@
+/* KPCC
+ * NodePager serves the nodes of a mapped snapshot on demand: a node is
+ * made from its record with no children, and its children are read when
+ * the engine first looks at them. When more nodes have their children
+ * read than the budget allows, the children of the oldest ones are
+ * dropped, to be read again if needed, so a pattern bigger than the
+ * memory can be browsed and run
+ * File: nodepager.h
+ */
+
+#ifndef NODEPAGER_H
+#define NODEPAGER_H
+
+#include <memory>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include "snapshot.h"
+#include "treebuilder.h"
+#include "treenode.h"
+
+using namespace std;
+
+class NodePager : public enable_shared_from_this<NodePager>
+{
+    friend class TreeNode;
+
+private:
+    // where a paged node comes from
+    struct PagedNode
+    {
+        shared_ptr<NodePager> pager; // keeps the file mapped
+        quint32 record;              // the number of the node in the table
+    };
+
+    // of all the paged nodes that exist; kept here rather than in the
+    // nodes, so that the other nodes are not any bigger. Paged trees are
+    // used from one thread. The table is never destroyed: the memo may
+    // still hold paged nodes when the program exits
+    static QHash<const TreeNode *, PagedNode> &pagedNodes();
+
+    QFile file;
+    const uchar *data;
+    const Snapshot::Record *records;
+    Snapshot::Header header;
+    // the hashes of the records of a version 1 file, which has none;
+    // empty for later versions
+    QVector<quint32> hashes;
+    TreeBuilder builder; // empty nodes and the children of 8x8 nodes
+    // paged nodes that exist, by record, so that a node read twice is
+    // one object, as it is one record
+    QHash<quint32, weak_ptr<TreeNode> > live;
+    // nodes with their children read, in the order of reading
+    QMap<quint64, const TreeNode *> loadOrder;
+    QHash<const TreeNode *, quint64> loadTime;
+    quint64 clock;
+    int budget;
+
+    NodePager();
+
+    // node "number" of the table, a level "level" one; 0 - an empty node
+    shared_ptr<TreeNode> node(quint32 number, int level);
+
+    // reads the children of node "record"
+    void load(const TreeNode *node, quint32 record);
+
+    // a paged node is destroyed
+    void forget(const TreeNode *node, quint32 record);
+
+    // for TreeNode: reads the children of a paged node
+    static void pageIn(const TreeNode *node);
+
+    // for TreeNode: a paged node is destroyed
+    static void release(const TreeNode *node);
+
+public:
+    ~NodePager();
+
+    // nullptr if the file can not be mapped or is not a valid snapshot
+    static shared_ptr<NodePager> open(const QString &fileName);
+
+    shared_ptr<TreeNode> root();
+    long long getGeneration() const;
+    // the step in progress when the snapshot was saved, -1 if none
+    int getStepLog2() const;
+
+    // how many nodes may have their children read at once. The results
+    // the memo keeps are not counted: they grow as for any field, until
+    // trim clears them
+    void setBudget(int nodes);
+    int getBudget() const;
+
+    // nodes that have their children read now
+    int loadedCount() const;
+
+    // once more nodes than the budget have their children read, drops the
+    // children of the oldest ones until a quarter of the budget is free,
+    // and clears the memo of TreeNode: its keys and results hold nodes
+    // too, and would keep the dropped children alive. Node references
+    // taken from children are invalidated, so the pager is only trimmed
+    // between operations on the tree
+    void trim();
+
+    // the default budget; each such node keeps up to four more alive
+    static const int defaultBudget = 1 << 20;
+};
+
+#endif // NODEPAGER_H
@@ -0,0 +1,328 @@
+/* KPCC
+ * PlainTextReader reads plain text, Life 1.05 and Life 1.06 files into a
+ * TreeBuilder
+ * File: plaintextreader.cpp
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <QByteArray>
+#include <QFile>
+
+#include "plaintextreader.h"
+
+// cells further than that do not fit into the field
+static const long long maxCoordinate = 1LL << 30;
+
+// reads an integer at "p", skipping spaces before it; false if there is
+// none or it is too big
+static bool readNumber(const char *&p, const char *end, long long &value)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+    value = 0;
+    while (p < end && '0' <= *p && *p <= '9')
+    {
+        value = 10 * value + (*p++ - '0');
+        if (value > maxCoordinate)
+        {
+            return false;
+        }
+    }
+    if (negative)
+    {
+        value = -value;
+    }
+    return true;
+}
+
+static bool startsWith(const char *data, int length, const char *prefix)
+{
+    int n = strlen(prefix);
+    return length >= n && strncmp(data, prefix, n) == 0;
+}
+
+PlainTextReader::PlainTextReader(TreeBuilder &builder,
+                                 FileProgress *progress)
+    : builder(builder), progress(progress)
+{
+    format = PlainText;
+    building = false;
+    lineNumber = 0;
+    row = 0;
+    blockX = 0;
+    blockY = 0;
+    hasCells = false;
+    left = 0;
+    right = 0;
+    top = 0;
+    bottom = 0;
+    level = 3;
+    originX = 0;
+    originY = 0;
+}
+
+shared_ptr<TreeNode> PlainTextReader::getTree() const
+{
+    return tree;
+}
+
+// the first reading only measures the pattern; the second one builds it
+bool PlainTextReader::addRun(long long x, long long y, long long length)
+{
+    if (!building)
+    {
+        if (x < -maxCoordinate || x + length > maxCoordinate ||
+            y < -maxCoordinate || y >= maxCoordinate)
+        {
+            return false;
+        }
+        left = hasCells ? min(left, x) : x;
+        right = hasCells ? max(right, x + length - 1) : x + length - 1;
+        top = hasCells ? min(top, y) : y;
+        bottom = hasCells ? max(bottom, y) : y;
+        hasCells = true;
+        return true;
+    }
+    if (format == PlainText)
+    {
+        // rows come in order, so they go to the builder at once
+        return builder.addRun(originX + x, originY + y, length);
+    }
+    Run run;
+    run.y = originY + y;
+    run.x = originX + x;
+    run.length = length;
+    runs.push_back(run);
+    return runs.size() < batchSize || flushRuns();
+}
+
+// every character but '.' and spaces is a living cell
+bool PlainTextReader::readRow(const char *data,
+                              int length,
+                              long long x,
+                              long long y)
+{
+    int start = -1; // of the run of living cells, -1 if there is none
+    for (int i = 0; i <= length; i++)
+    {
+        bool alive = i < length && data[i] != '.' && data[i] != ' ' &&
+                     data[i] != '\t';
+        if (alive && start < 0)
+        {
+            start = i;
+        }
+        if (!alive && start >= 0)
+        {
+            if (!addRun(x + start, y, i - start))
+            {
+                return false;
+            }
+            start = -1;
+        }
+    }
+    return true;
+}
+
+bool PlainTextReader::readLine(const char *data, int length)
+{
+    while (length > 0 && (data[length - 1] == '\r' ||
+                          data[length - 1] == '\n'))
+    {
+        length--;
+    }
+    if (lineNumber++ == 0)
+    {
+        if (startsWith(data, length, "#Life 1.06"))
+        {
+            format = Life106;
+            return true;
+        }
+        if (startsWith(data, length, "#Life 1.05"))
+        {
+            format = Life105;
+            return true;
+        }
+        format = PlainText;
+    }
+    const char *end = data + length;
+    switch (format)
+    {
+    case PlainText:
+        if (length > 0 && data[0] == '!')
+        {
+            return true;
+        }
+        return readRow(data, length, 0, row++);
+    case Life105:
+        if (startsWith(data, length, "#P"))
+        {
+            const char *p = data + 2;
+            row = 0;
+            return readNumber(p, end, blockX) && readNumber(p, end, blockY);
+        }
+        if (startsWith(data, length, "#R"))
+        {
+            QByteArray rule = QByteArray(data + 2, length - 2).trimmed()
+                                  .toUpper();
+            return rule == "23/3" || rule == "B3/S23";
+        }
+        if (length > 0 && data[0] == '#')
+        {
+            return true; // "#D" description, "#N" normal rules
+        }
+        return readRow(data, length, blockX, blockY + row++);
+    case Life106:
+        if (length == 0 || data[0] == '#')
+        {
+            return true;
+        }
+        {
+            const char *p = data;
+            long long x;
+            long long y;
+            return readNumber(p, end, x) && readNumber(p, end, y) &&
+                   addRun(x, y, 1);
+        }
+    }
+    return false;
+}
+
+/**
+*   Chooses the level of the tree and where the file goes in it: the
+*   centre of the tree is the centre of a plain text pattern, as it was
+*   before, and (0, 0) of Life 1.05 and 1.06, whose coordinates are
+*   relative to it.
+*/
+bool PlainTextReader::placePattern()
+{
+    level = 3;
+    if (!hasCells)
+    {
+        return true;
+    }
+    long long centreX = 0;
+    long long centreY = 0;
+    if (format == PlainText)
+    {
+        centreX = (right + 1) / 2;
+        centreY = (bottom + 1) / 2;
+    }
+    while (centreX - left > (1LL << (level - 1)) ||
+           right - centreX >= (1LL << (level - 1)) ||
+           centreY - top > (1LL << (level - 1)) ||
+           bottom - centreY >= (1LL << (level - 1)))
+    {
+        level++;
+    }
+    if ((1LL << level) > 2 * maxCoordinate)
+    {
+        return false; // the coordinates of the tree would not fit into int
+    }
+    originX = (1LL << (level - 1)) - centreX;
+    originY = (1LL << (level - 1)) - centreY;
+    return true;
+}
+
+// builds a tree of the runs collected and adds it to the tree so far
+bool PlainTextReader::flushRuns()
+{
+    sort(runs.begin(), runs.end());
+    foreach (const Run &run, runs)
+    {
+        if (!builder.addRun(run.x, run.y, run.length))
+        {
+            return false;
+        }
+    }
+    runs.clear();
+    shared_ptr<TreeNode> part = builder.finish(level);
+    if (tree == nullptr)
+    {
+        tree = part;
+        return true;
+    }
+    if (part->getLevel() != tree->getLevel())
+    {
+        return false;
+    }
+    tree = TreeBuilder::unite(tree, part);
+    return true;
+}
+
+// false if reading was cancelled
+bool PlainTextReader::report(qint64 position, qint64 fileSize)
+{
+    if (progress == nullptr || lineNumber % linesPerReport != 0)
+    {
+        return true;
+    }
+    return progress->report((building ? fileSize : 0) + position,
+                            2 * fileSize);
+}
+
+bool PlainTextReader::read(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    uchar *data = file.size() > 0 ? file.map(0, file.size()) : nullptr;
+    bool success = true;
+    for (int pass = 0; pass < 2 && success; pass++)
+    {
+        building = pass == 1;
+        lineNumber = 0;
+        row = 0;
+        blockX = 0;
+        blockY = 0;
+        if (data != nullptr)
+        {
+            const char *p = (const char *)data;
+            const char *end = p + file.size();
+            while (success && p < end)
+            {
+                const char *eol = (const char *)memchr(p, '\n', end - p);
+                if (eol == nullptr)
+                {
+                    eol = end;
+                }
+                success = readLine(p, eol - p) &&
+                          report(eol - (const char *)data, file.size());
+                p = eol + 1;
+            }
+        }
+        else
+        {
+            // resources and some devices can not be mapped
+            success = file.seek(0);
+            while (success && !file.atEnd())
+            {
+                QByteArray line = file.readLine();
+                success = readLine(line.constData(), line.size()) &&
+                          report(file.pos(), file.size());
+            }
+        }
+        if (success && !building)
+        {
+            success = placePattern();
+        }
+    }
+    if (data != nullptr)
+    {
+        file.unmap(data);
+    }
+    return success && flushRuns();
+}
@@ -0,0 +1,91 @@
+/* KPCC
+ * PlainTextReader reads the line based formats - plain text (.cells) and
+ * Life 1.05 and 1.06 - into a TreeBuilder. The file is read twice, the
+ * first time to find the size of the pattern, so nothing but the tree
+ * and a bounded number of runs is kept in memory
+ * File: plaintextreader.h
+ */
+
+#ifndef PLAINTEXTREADER_H
+#define PLAINTEXTREADER_H
+
+#include <memory>
+#include <QString>
+#include <QVector>
+
+#include "fileprogress.h"
+#include "treebuilder.h"
+
+using namespace std;
+
+class PlainTextReader
+{
+private:
+    enum Format
+    {
+        PlainText, // rows of '.' and 'O', "!" comments
+        Life105,   // rows of '.' and '*' in "#P x y" blocks
+        Life106    // "x y" of every living cell, in any order
+    };
+
+    // living cells [x, x + length) of row y, in the tree
+    struct Run
+    {
+        int y;
+        int x;
+        int length;
+
+        bool operator<(const Run &other) const
+        {
+            return y != other.y ? y < other.y : x < other.x;
+        }
+    };
+
+    // runs of Life 1.05 and 1.06 are sorted in batches of that many
+    static const int batchSize = 1 << 20;
+
+    // progress is reported every that many lines
+    static const int linesPerReport = 1 << 12;
+
+    TreeBuilder &builder;
+    FileProgress *progress; // may be nullptr
+    Format format;
+    bool building;     // false in the first reading, true in the second
+    int lineNumber;
+    long long row;     // of the file: the line of plain text, or of a block
+    long long blockX;  // "#P x y" of the current Life 1.05 block
+    long long blockY;
+    bool hasCells;
+    long long left;    // the bounding box of the file
+    long long right;
+    long long top;
+    long long bottom;
+    int level;
+    long long originX; // cell (x, y) of the file is put at
+    long long originY; // (originX + x, originY + y) of the tree
+    QVector<Run> runs; // not given to the builder yet
+    shared_ptr<TreeNode> tree;
+
+    bool readLine(const char *data, int length);
+    bool readRow(const char *data, int length, long long x, long long y);
+    bool addRun(long long x, long long y, long long length);
+    bool placePattern();
+    bool flushRuns();
+    bool report(qint64 position, qint64 fileSize);
+
+public:
+    // the cells will be added to "builder"; the bytes read (twice) are
+    // reported to "progress", if given
+    explicit PlainTextReader(TreeBuilder &builder,
+                             FileProgress *progress = nullptr);
+
+    // false if the file can not be read or is not valid, or if reading was
+    // cancelled
+    bool read(const QString &fileName);
+
+    // the pattern read, its centre at the centre of the tree: the centre of
+    // a plain text pattern, and (0, 0) of Life 1.05 and 1.06
+    shared_ptr<TreeNode> getTree() const;
+};
+
+#endif // PLAINTEXTREADER_H
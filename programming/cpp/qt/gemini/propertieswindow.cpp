@@ -16,10 +16,37 @@ PropertiesWindow::PropertiesWindow(QWidget *parent)
 
     hashSizeLabel = new QLabel(tr("Items in hash: "));
 
+    speedLabel = new QLabel(tr("Speed: "));
+
+    stepProgressLabel = new QLabel(tr("Step done: "));
+
+    stepTimeLabel = new QLabel(tr("Time per step: "));
+
+    repaintLabel = new QLabel(tr("Repainted: "));
+
+    memoLabel = new QLabel(tr("Memo hits: "));
+
+    nodesLabel = new QLabel(tr("Nodes: "));
+
+    memoryLabel = new QLabel(tr("Memory in nodes: "));
+
+    baseCasesLabel = new QLabel(tr("Base cases: "));
+
+    levelsLabel = new QLabel();
+
     mainLayout = new QVBoxLayout;
     mainLayout->addWidget(generationLabel);
     mainLayout->addWidget(populationLabel);
     mainLayout->addWidget(hashSizeLabel);
+    mainLayout->addWidget(speedLabel);
+    mainLayout->addWidget(stepProgressLabel);
+    mainLayout->addWidget(stepTimeLabel);
+    mainLayout->addWidget(repaintLabel);
+    mainLayout->addWidget(memoLabel);
+    mainLayout->addWidget(nodesLabel);
+    mainLayout->addWidget(memoryLabel);
+    mainLayout->addWidget(baseCasesLabel);
+    mainLayout->addWidget(levelsLabel);
 
     setWindowTitle(tr("Properties"));
 
@@ -27,7 +54,7 @@ PropertiesWindow::PropertiesWindow(QWidget *parent)
     this->show();
 }
 
-void PropertiesWindow::setGeneration(int gen)
+void PropertiesWindow::setGeneration(long long gen)
 {
     generationLabel->setText(tr("Generation ") + QString::number(gen));
 }
@@ -42,6 +69,77 @@ void PropertiesWindow::setHashSize(int hs)
     hashSizeLabel->setText(tr("Items in hash: ") + QString::number(hs));
 }
 
+void PropertiesWindow::setSpeed(double rate, int stepLog2)
+{
+    speedLabel->setText(tr("Speed: ") + QString::number(rate, 'g', 4) +
+                        tr(" gen/s, step 2^") + QString::number(stepLog2));
+}
+
+void PropertiesWindow::setStepProgress(double progress)
+{
+    stepProgressLabel->setText(tr("Step done: ") +
+                               QString::number(qRound(progress * 100)) + "%");
+}
+
+void PropertiesWindow::setStepTime(double milliseconds)
+{
+    stepTimeLabel->setText(tr("Time per step: ") +
+                           QString::number(milliseconds, 'g', 4) + tr(" ms"));
+}
+
+void PropertiesWindow::setRepaintedShare(double share)
+{
+    repaintLabel->setText(tr("Repainted: ") +
+                          QString::number(share * 100, 'f', 1) +
+                          tr("% of the field"));
+}
+
+void PropertiesWindow::setMemoStats(long long hits, long long misses)
+{
+    long long lookups = hits + misses;
+    int rate = lookups > 0 ? qRound(100.0 * hits / lookups) : 0;
+    memoLabel->setText(tr("Memo hits: ") + QString::number(rate) +
+                       tr("% of ") + QString::number(lookups));
+}
+
+void PropertiesWindow::setNodeStats(long long alive, long long created)
+{
+    nodesLabel->setText(tr("Nodes: ") + QString::number(alive) +
+                        tr(" alive, ") + QString::number(created) +
+                        tr(" created"));
+}
+
+void PropertiesWindow::setMemoryInUse(long long bytes)
+{
+    memoryLabel->setText(tr("Memory in nodes: ") +
+                         QString::number(bytes / 1048576.0, 'f', 1) +
+                         tr(" MB"));
+}
+
+void PropertiesWindow::setBaseCases(long long baseCases, long long expansions)
+{
+    baseCasesLabel->setText(tr("Base cases: ") + QString::number(baseCases) +
+                            tr(", expansions: ") +
+                            QString::number(expansions));
+}
+
+void PropertiesWindow::setNodesPerLevel(const QVector<long long> &alive,
+                                        const QVector<long long> &created)
+{
+    QString text = tr("Level: alive / created");
+    for (int i = 0; i < alive.size() && i < created.size(); i++)
+    {
+        if (alive[i] == 0 && created[i] == 0)
+        {
+            continue;
+        }
+        text += "\n" + QString::number(i) + ": " +
+                QString::number(alive[i]) + " / " +
+                QString::number(created[i]);
+    }
+    levelsLabel->setText(text);
+}
+
 PropertiesWindow::~PropertiesWindow()
 {
 
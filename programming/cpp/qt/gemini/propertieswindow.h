@@ -11,6 +11,7 @@
 
 #include <QLabel>
 #include <QVBoxLayout>
+#include <QVector>
 #include <QWidget>
 
 #include "gridpainter.h"
@@ -23,12 +24,38 @@ private:
     QLabel *generationLabel;
     QLabel *populationLabel;
     QLabel *hashSizeLabel;
+    QLabel *speedLabel;
+    QLabel *stepProgressLabel;
+    QLabel *stepTimeLabel;
+    QLabel *repaintLabel;
+    QLabel *memoLabel;
+    QLabel *nodesLabel;
+    QLabel *memoryLabel;
+    QLabel *baseCasesLabel;
+    QLabel *levelsLabel;
     QVBoxLayout *mainLayout;
 
 public:
-    void setGeneration(int gen);
+    void setGeneration(long long gen);
     void setPopulation(int pop);
     void setHashSize(int hs);
+    // generations per second actually computed, and the step (2^stepLog2)
+    void setSpeed(double rate, int stepLog2);
+    // how much of the current step is computed, from 0 to 1
+    void setStepProgress(double progress);
+    // average time of the steps finished lately
+    void setStepTime(double milliseconds);
+    // the part of the field painted again by the latest frames, from 0
+    // to 1
+    void setRepaintedShare(double share);
+    // engine counters, see EngineStats
+    void setMemoStats(long long hits, long long misses);
+    void setNodeStats(long long alive, long long created);
+    void setMemoryInUse(long long bytes);
+    void setBaseCases(long long baseCases, long long expansions);
+    // alive[i] and created[i] are the numbers of nodes of level i
+    void setNodesPerLevel(const QVector<long long> &alive,
+                          const QVector<long long> &created);
     PropertiesWindow(QWidget *parent = 0);
     ~PropertiesWindow();
 };
@@ -0,0 +1,466 @@
+/* KPCC
+ * Rasterizer draws TreeNodes straight into an image
+ * File: rasterizer.cpp
+ */
+
+#ifdef QT_GUI_LIB
+
+#include <algorithm>
+#include <cmath>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+
+#include "enginestats.h"
+#include "rasterizer.h"
+
+Rasterizer::Rasterizer()
+{
+    tiles.setMaxCost(defaultTileBudget);
+    setColorMap(QColor(70, 0, 140), QColor(255, 230, 0));
+}
+
+QRect Rasterizer::begin(const QSize &size,
+                        const QColor &background,
+                        const QRect &area)
+{
+    if (image.size() != size)
+    {
+        image = QImage(size, QImage::Format_RGB32);
+        this->area = image.rect();
+    }
+    else
+    {
+        this->area = area & image.rect();
+    }
+    QRgb color = background.rgb();
+    for (int y = this->area.top(); y <= this->area.bottom(); y++)
+    {
+        QRgb *line = (QRgb *)image.scanLine(y);
+        std::fill(line + this->area.left(), line + this->area.right() + 1,
+                  color);
+    }
+    return this->area;
+}
+
+const QImage &Rasterizer::getImage() const
+{
+    return image;
+}
+
+void Rasterizer::setTileBudget(int bytes)
+{
+    QMutexLocker locker(&tilesMutex);
+    tiles.setMaxCost(max(bytes, 0));
+}
+
+int Rasterizer::getTileBudget() const
+{
+    return tiles.maxCost();
+}
+
+void Rasterizer::Band::run()
+{
+    rasterizer->drawNode(canvas, node, x, y);
+}
+
+void Rasterizer::setColorMap(const QColor &sparse, const QColor &dense)
+{
+    colorMap.resize(colorMapSize);
+    for (int i = 0; i < colorMapSize; i++)
+    {
+        double t = (double)i / (colorMapSize - 1);
+        colorMap[i] = qRgb(qRound(sparse.red() + t * (dense.red() -
+                                                      sparse.red())),
+                           qRound(sparse.green() + t * (dense.green() -
+                                                        sparse.green())),
+                           qRound(sparse.blue() + t * (dense.blue() -
+                                                       sparse.blue())));
+    }
+}
+
+Rasterizer::Canvas Rasterizer::viewCanvas(const QRect &rect,
+                                          const Viewport &view)
+{
+    Canvas canvas;
+    canvas.bits = (QRgb *)image.bits();
+    canvas.stride = image.bytesPerLine() / sizeof(QRgb);
+    canvas.left = rect.left();
+    canvas.right = rect.right() + 1;
+    canvas.top = rect.top();
+    canvas.bottom = rect.bottom() + 1;
+    canvas.color = 0;
+    canvas.scale = view.getScale();
+    canvas.originX = view.getOriginX();
+    canvas.originY = view.getOriginY();
+    canvas.tile = false;
+    canvas.colorMap = nullptr;
+    return canvas;
+}
+
+void Rasterizer::draw(const TreeNode *node,
+                      qint64 left,
+                      qint64 top,
+                      const Viewport &view,
+                      const QColor &color,
+                      bool parallel)
+{
+    Canvas canvas = viewCanvas(area, view);
+    canvas.color = color.rgb();
+    drawCanvas(canvas, node, left - view.getCenterX(),
+               top - view.getCenterY(), parallel);
+}
+
+/**
+*   Tiles hold no density, so none are used: a frame costs about what
+*   drawing without tiles does, a node per pixel at most.
+*/
+void Rasterizer::drawDensity(const TreeNode *node,
+                             qint64 left,
+                             qint64 top,
+                             const Viewport &view,
+                             bool parallel)
+{
+    Canvas canvas = viewCanvas(area, view);
+    canvas.color = colorMap.last();
+    canvas.colorMap = colorMap.constData();
+    drawCanvas(canvas, node, left - view.getCenterX(),
+               top - view.getCenterY(), parallel);
+}
+
+/**
+*   A band is a range of whole lines, so the bands write to different
+*   pixels and need no locking but that of the tiles. A node on the edge
+*   of two bands is visited by both, each drawing its own part.
+*/
+void Rasterizer::drawCanvas(const Canvas &canvas,
+                            const TreeNode *node,
+                            qint64 x,
+                            qint64 y,
+                            bool parallel)
+{
+    int bands = 1;
+    if (parallel)
+    {
+        bands = min(pool.maxThreadCount() * bandsPerThread,
+                    area.height() / minBandHeight);
+    }
+    if (bands <= 1)
+    {
+        drawNode(canvas, node, x, y);
+        return;
+    }
+    for (int i = 0; i < bands; i++)
+    {
+        Band *band = new Band; // deleted by the pool when it is done
+        band->rasterizer = this;
+        band->canvas = canvas;
+        band->canvas.top = area.top() + area.height() * i / bands;
+        band->canvas.bottom = area.top() + area.height() * (i + 1) / bands;
+        band->node = node;
+        band->x = x;
+        band->y = y;
+        pool.start(band);
+    }
+    pool.waitForDone();
+}
+
+long long Rasterizer::pixel(double position)
+{
+    // far beyond any image, and as far from the limits of long long
+    double limit = (double)(1LL << 40);
+    return (long long)floor(min(max(position, -limit), limit));
+}
+
+// fills the rectangle [left, left + width) x [top, top + height), clipped
+// to the canvas
+void Rasterizer::fill(const Canvas &canvas,
+                      long long left,
+                      long long top,
+                      long long width,
+                      long long height,
+                      QRgb color)
+{
+    int x1 = (int)max(left, (long long)canvas.left);
+    int x2 = (int)min(left + width, (long long)canvas.right);
+    int y1 = (int)max(top, (long long)canvas.top);
+    int y2 = (int)min(top + height, (long long)canvas.bottom);
+    if (x1 >= x2)
+    {
+        return; // the rectangle is beside the canvas
+    }
+    for (int y = y1; y < y2; y++)
+    {
+        QRgb *line = canvas.bits + (qint64)y * canvas.stride;
+        std::fill(line + x1, line + x2, color);
+    }
+}
+
+/**
+*   Cells are counted from the centre of the view, so only the distance
+*   from it becomes a double: the cells on the screen are placed exactly
+*   however far the view is from cell 0. The edges of a node are those of
+*   its first cell and of the cell after its last, so nodes side by side
+*   meet without gaps at any scale.
+*/
+void Rasterizer::drawNode(const Canvas &canvas,
+                          const TreeNode *node,
+                          qint64 x,
+                          qint64 y)
+{
+    if (node->population == 0)
+    {
+        return;
+    }
+    qint64 size = (qint64)1 << node->level;
+    double left = x * canvas.scale + canvas.originX;
+    double right = (x + size) * canvas.scale + canvas.originX;
+    double top = y * canvas.scale + canvas.originY;
+    double bottom = (y + size) * canvas.scale + canvas.originY;
+    if (left >= canvas.right || right <= canvas.left ||
+        top >= canvas.bottom || bottom <= canvas.top)
+    {
+        return;
+    }
+    if (size * canvas.scale < 1)
+    {
+        // the node is drawn as the pixel its centre is in
+        QRgb color = canvas.color;
+        if (canvas.colorMap != nullptr)
+        {
+            // log2 of the share of living cells, from -2 * level to 0
+            double density = log2((double)node->population) -
+                             2 * node->level;
+            int index = colorMapSize - 1 +
+                        (int)(density * (colorMapSize - 1) / densityRange);
+            color = canvas.colorMap[qBound(0, index, colorMapSize - 1)];
+        }
+        fill(canvas, pixel((left + right) / 2), pixel((top + bottom) / 2),
+             1, 1, color);
+        return;
+    }
+    long long x1 = pixel(left);
+    long long x2 = pixel(right);
+    long long y1 = pixel(top);
+    long long y2 = pixel(bottom);
+    // the edges may fall inside the pixels next to the canvas: a node
+    // covers its pixels from x1 to x2, the pixel of its right edge not
+    // included
+    if (x1 >= canvas.right || x2 <= canvas.left ||
+        y1 >= canvas.bottom || y2 <= canvas.top)
+    {
+        return;
+    }
+    if (node->level <= 30 &&
+        node->population == (long long)1 << (2 * node->level))
+    {
+        fill(canvas, x1, y1, x2 - x1, y2 - y1, canvas.color);
+        return;
+    }
+    if (x2 - x1 <= tileSize && y2 - y1 <= tileSize && node->level > 1 &&
+        !canvas.tile && canvas.colorMap == nullptr)
+    {
+        TileKey key;
+        key.node = node;
+        key.scale = canvas.scale;
+        key.phaseX = left - floor(left);
+        key.phaseY = top - floor(top);
+        key.width = (int)(x2 - x1);
+        key.height = (int)(y2 - y1);
+        drawTile(canvas, key, x1, y1);
+        return;
+    }
+    qint64 half = size / 2;
+    drawNode(canvas, node->nw().get(), x, y);
+    drawNode(canvas, node->ne().get(), x + half, y);
+    drawNode(canvas, node->sw().get(), x, y + half);
+    drawNode(canvas, node->se().get(), x + half, y + half);
+}
+
+/**
+*   Inside a node, cells are placed from its corner, whose place within a
+*   pixel is part of the key: a node drawn at a given scale and phase
+*   looks the same wherever it is, and one mask serves every place it is
+*   met. At a whole number of pixels per cell, or a power of two cells per
+*   pixel, the phases repeat all over the field; in a still view a node
+*   that stays where it is keeps its tile at any scale. Runs of set bits
+*   are filled a scanline at a time. Two bands may make the same tile at
+*   once; then the later one is kept.
+*/
+void Rasterizer::drawTile(const Canvas &canvas,
+                          const TileKey &key,
+                          long long left,
+                          long long top)
+{
+    shared_ptr<const Tile> tile;
+    {
+        QMutexLocker locker(&tilesMutex);
+        shared_ptr<const Tile> *cached = tiles.object(key);
+        if (cached != nullptr && !(*cached)->node.expired())
+        {
+            tile = *cached;
+        }
+    }
+    if (tile == nullptr)
+    {
+        EngineStats::add(EngineStats::TileMisses);
+        tile = makeTile(key);
+        // the node, with its counts, stays allocated while the tile lives
+        int cost = key.height * sizeof(quint64) + sizeof(Tile) +
+                   sizeof(TreeNode);
+        QMutexLocker locker(&tilesMutex);
+        tiles.insert(key, new shared_ptr<const Tile>(tile), cost);
+    }
+    else
+    {
+        EngineStats::add(EngineStats::TileHits);
+    }
+
+    // the columns and rows of the tile inside the canvas
+    int x1 = (int)max(canvas.left - left, 0LL);
+    int x2 = (int)min((long long)key.width, canvas.right - left);
+    int y1 = (int)max(canvas.top - top, 0LL);
+    int y2 = (int)min((long long)key.height, canvas.bottom - top);
+    if (x1 >= x2 || y1 >= y2)
+    {
+        return; // the tile is beside the canvas
+    }
+    quint64 columns = ~0ULL << x1;
+    if (x2 < 64)
+    {
+        columns &= (1ULL << x2) - 1;
+    }
+    for (int y = y1; y < y2; y++)
+    {
+        QRgb *line = canvas.bits + (qint64)(top + y) * canvas.stride + left;
+        quint64 row = tile->rows[y] & columns;
+        while (row != 0)
+        {
+            int start = qCountTrailingZeroBits(row);
+            int end = start + qCountTrailingZeroBits(~(row >> start));
+            std::fill(line + start, line + end, canvas.color);
+            row = end < 64 ? row & (~0ULL << end) : 0;
+        }
+    }
+}
+
+// draws the node into a canvas of its own, with its corner at the phase
+// of the key within pixel (0, 0), and reads the mask from it
+shared_ptr<const Rasterizer::Tile> Rasterizer::makeTile(const TileKey &key)
+{
+    QVector<QRgb> pixels(key.width * key.height, 0);
+    Canvas canvas;
+    canvas.bits = pixels.data();
+    canvas.stride = canvas.right = key.width;
+    canvas.bottom = key.height;
+    canvas.left = canvas.top = 0;
+    canvas.color = 1;
+    canvas.scale = key.scale;
+    canvas.originX = key.phaseX;
+    canvas.originY = key.phaseY;
+    canvas.tile = true;
+    canvas.colorMap = nullptr;
+    drawNode(canvas, key.node, 0, 0);
+
+    shared_ptr<Tile> tile(new Tile);
+    tile->node = key.node->shared_from_this();
+    tile->rows.fill(0, key.height);
+    for (int y = 0; y < key.height; y++)
+    {
+        for (int x = 0; x < key.width; x++)
+        {
+            if (pixels[y * key.width + x] != 0)
+            {
+                tile->rows[y] |= 1ULL << x;
+            }
+        }
+    }
+    return tile;
+}
+
+QRegion Rasterizer::changes(const TreeNode *before,
+                            const TreeNode *after,
+                            qint64 left,
+                            qint64 top,
+                            const Viewport &view) const
+{
+    // nothing is drawn into it, so the image is not needed; it may not
+    // have the size of the widget yet, either
+    Canvas canvas;
+    canvas.bits = nullptr;
+    canvas.left = canvas.top = 0;
+    canvas.right = view.getSize().width();
+    canvas.bottom = view.getSize().height();
+    canvas.scale = view.getScale();
+    canvas.originX = view.getOriginX();
+    canvas.originY = view.getOriginY();
+    QVector<QRect> rects;
+    if (before == nullptr || before->level != after->level ||
+        !diffNode(canvas, before, after, left - view.getCenterX(),
+                  top - view.getCenterY(), rects))
+    {
+        return QRegion(QRect(QPoint(0, 0), view.getSize()));
+    }
+    QRegion region;
+    for (int i = 0; i < rects.size(); i++)
+    {
+        region += rects[i];
+    }
+    return region;
+}
+
+/**
+*   The nodes are placed as in drawNode. Nodes are not made unique, so
+*   two different nodes may hold the same cells; they are taken as
+*   changed, which only paints a little more than needed.
+*/
+bool Rasterizer::diffNode(const Canvas &canvas,
+                          const TreeNode *before,
+                          const TreeNode *after,
+                          qint64 x,
+                          qint64 y,
+                          QVector<QRect> &rects) const
+{
+    if (before == after ||
+        (before->population == 0 && after->population == 0))
+    {
+        return true;
+    }
+    qint64 size = (qint64)1 << after->level;
+    double left = x * canvas.scale + canvas.originX;
+    double right = (x + size) * canvas.scale + canvas.originX;
+    double top = y * canvas.scale + canvas.originY;
+    double bottom = (y + size) * canvas.scale + canvas.originY;
+    if (left >= canvas.right || right <= canvas.left ||
+        top >= canvas.bottom || bottom <= canvas.top)
+    {
+        return true;
+    }
+    if (right - left <= tileSize || after->level == 0)
+    {
+        if (rects.size() == maxChangedRects)
+        {
+            return false;
+        }
+        // with the pixel a node inside a pixel is drawn in
+        long long x1 = max(pixel(left), (long long)canvas.left);
+        long long x2 = min(max(pixel(right), pixel(left) + 1),
+                           (long long)canvas.right);
+        long long y1 = max(pixel(top), (long long)canvas.top);
+        long long y2 = min(max(pixel(bottom), pixel(top) + 1),
+                           (long long)canvas.bottom);
+        rects.append(QRect((int)x1, (int)y1, (int)(x2 - x1),
+                           (int)(y2 - y1)));
+        return true;
+    }
+    qint64 half = size / 2;
+    return diffNode(canvas, before->nw().get(), after->nw().get(),
+                    x, y, rects) &&
+           diffNode(canvas, before->ne().get(), after->ne().get(),
+                    x + half, y, rects) &&
+           diffNode(canvas, before->sw().get(), after->sw().get(),
+                    x, y + half, rects) &&
+           diffNode(canvas, before->se().get(), after->se().get(),
+                    x + half, y + half, rects);
+}
+
+#endif // QT_GUI_LIB
@@ -0,0 +1,244 @@
+/* KPCC
+ * Rasterizer draws TreeNodes by writing the pixels of living cells
+ * straight into an image, which is kept from frame to frame and shown
+ * with one call, instead of asking a QPainter for a rectangle per cell.
+ * Cells are placed through a Viewport, at any scale, a cell covering
+ * the pixels between the edges of its column and row rounded down; a
+ * node narrower than a pixel is drawn as the pixel its centre is in.
+ * Nodes a tile wide or less are drawn once into a bit mask per node,
+ * scale and place within a pixel, which is kept in an LRU cache; the
+ * same node met again, in this frame or a later one, is copied from its
+ * mask. Subtrees shared by the
+ * tree, such as the streams of a gun or a still field, are drawn once.
+ * A big image is cut into bands, which the threads of a pool of its own
+ * draw at once. A frame may be drawn over a part of the previous one
+ * only; the parts in which two trees differ are found by comparing them.
+ * Instead of the cells, the density of the population can be drawn:
+ * each pixel is coloured by the share of living cells in the node it
+ * shows, read from the population the node keeps.
+ * Like the rest of the drawing code, it is compiled only with QtGui
+ * File: rasterizer.h
+ */
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#ifdef QT_GUI_LIB
+
+#include <memory>
+#include <QCache>
+#include <QColor>
+#include <QImage>
+#include <QMutex>
+#include <QRect>
+#include <QRegion>
+#include <QRunnable>
+#include <QSize>
+#include <QThreadPool>
+#include <QVector>
+
+#include "treenode.h"
+#include "viewport.h"
+
+using namespace std;
+
+class Rasterizer
+{
+private:
+    // the cells of a node drawn into "rows.size()" rows of pixels
+    struct Tile
+    {
+        // the address of a destroyed node may be given to a new one, so a
+        // tile is used only while this has not expired
+        weak_ptr<const TreeNode> node;
+        QVector<quint64> rows; // bit x of rows[y] is pixel (x, y)
+    };
+
+    // a node, how it is drawn and its size in pixels
+    struct TileKey
+    {
+        const TreeNode *node;
+        double scale;
+        double phaseX; // where its corner is within a pixel
+        double phaseY;
+        int width;
+        int height;
+
+        bool operator==(const TileKey &other) const
+        {
+            return node == other.node && scale == other.scale &&
+                   phaseX == other.phaseX && phaseY == other.phaseY &&
+                   width == other.width && height == other.height;
+        }
+
+        friend uint qHash(const TileKey &key)
+        {
+            return qHash(key.node) ^ qHash(key.scale) ^
+                   qHash(key.phaseX) * 31 ^ qHash(key.phaseY) * 37 ^
+                   (key.width << 16 | key.height);
+        }
+    };
+
+    // where one thread draws: a band of the image, or a tile being made
+    struct Canvas
+    {
+        QRgb *bits;        // the first line of the image
+        int stride;        // pixels from a line to the next
+        int left;          // the pixels drawn are [left, right) x
+        int right;         // [top, bottom)
+        int top;
+        int bottom;
+        QRgb color;        // of the cells being drawn
+        double scale;      // pixels per cell
+        double originX;    // the pixel at which cell (0, 0) starts
+        double originY;
+        bool tile;         // true while a tile is made
+        // if not null, nodes of a pixel or less are coloured by density
+        const QRgb *colorMap;
+    };
+
+    // draws a node into one band of the image, on a thread of the pool
+    class Band : public QRunnable
+    {
+    public:
+        Rasterizer *rasterizer;
+        Canvas canvas;
+        const TreeNode *node;
+        qint64 x;
+        qint64 y;
+
+        void run() override;
+    };
+
+    QImage image;
+    QRect area; // the part of the image being drawn
+    // tiles are shared by the bands; a tile is taken out as a shared_ptr,
+    // so it can be used while another band drops it from the cache
+    QCache<TileKey, shared_ptr<const Tile> > tiles;
+    QMutex tilesMutex;
+    // colours from the sparsest to the densest nodes
+    QVector<QRgb> colorMap;
+    // of the rasterizer alone, so drawing does not wait for the loading
+    // and saving of files, which use the global pool
+    QThreadPool pool;
+
+    // a canvas over "rect" of the image, with cell (0, 0) at the centre
+    // of "view"
+    Canvas viewCanvas(const QRect &rect, const Viewport &view);
+
+    // draws the node into the canvas, cut into bands if "parallel"
+    void drawCanvas(const Canvas &canvas,
+                    const TreeNode *node,
+                    qint64 x,
+                    qint64 y,
+                    bool parallel);
+
+    // the pixel a position is in, kept far enough from the limits of
+    // long long to be added to
+    static long long pixel(double position);
+
+    void fill(const Canvas &canvas,
+              long long left,
+              long long top,
+              long long width,
+              long long height,
+              QRgb color);
+
+    // draws the node whose top left cell is (x, y)
+    void drawNode(const Canvas &canvas,
+                  const TreeNode *node,
+                  qint64 x,
+                  qint64 y);
+
+    // draws the node from its tile, making the tile first if there is
+    // none; "key" tells where and how big the node is within its pixels,
+    // whose top left one is (left, top)
+    void drawTile(const Canvas &canvas,
+                  const TileKey &key,
+                  long long left,
+                  long long top);
+    shared_ptr<const Tile> makeTile(const TileKey &key);
+
+    // adds the rectangles in which "before" and "after" differ to
+    // "rects"; false if there are more than maxChangedRects of them
+    bool diffNode(const Canvas &canvas,
+                  const TreeNode *before,
+                  const TreeNode *after,
+                  qint64 x,
+                  qint64 y,
+                  QVector<QRect> &rects) const;
+
+public:
+    Rasterizer();
+
+    // starts drawing "area" of a frame of "size" pixels: it is filled
+    // with "background" and the rest of the image keeps the previous
+    // frame. The image is made again when the size changes, and then all
+    // of it is drawn. Returns the part that is drawn
+    QRect begin(const QSize &size,
+                const QColor &background,
+                const QRect &area);
+
+    // draws the living cells of "node" in "color", its top left cell
+    // being cell (left, top) of "view". Only the part in the image is
+    // visited; a node narrower than a pixel, and a full node, are filled
+    // at once.
+    // If "parallel", the image is cut into horizontal bands that are
+    // drawn by the threads of the pool at once; the tree must not change
+    // meanwhile, and must not be a paged one, whose nodes change when
+    // they are looked at
+    void draw(const TreeNode *node,
+              qint64 left,
+              qint64 top,
+              const Viewport &view,
+              const QColor &color,
+              bool parallel = false);
+
+    // the same as draw, but each pixel that holds a node gets the colour
+    // of its density from the colour map; cells a pixel or wider are
+    // fully dense
+    void drawDensity(const TreeNode *node,
+                     qint64 left,
+                     qint64 top,
+                     const Viewport &view,
+                     bool parallel = false);
+
+    // the colour map of drawDensity goes from "sparse", for one living
+    // cell in 2^densityRange, to "dense", for all cells living; densities
+    // in between are on a log scale
+    void setColorMap(const QColor &sparse, const QColor &dense);
+
+    // the frame drawn so far
+    const QImage &getImage() const;
+
+    // the part of the widget of "view" in which "after" differs from
+    // "before", both placed as by draw. Subtrees that are the same node
+    // are the same; others are compared down to nodes a tile wide. If the
+    // differences are too scattered, the whole widget is returned
+    QRegion changes(const TreeNode *before,
+                    const TreeNode *after,
+                    qint64 left,
+                    qint64 top,
+                    const Viewport &view) const;
+
+    // how many bytes the tiles may take; the least recently used ones are
+    // dropped first
+    void setTileBudget(int bytes);
+    int getTileBudget() const;
+
+    // the widest node that is drawn from a tile; it fits a quint64
+    static const int tileSize = 64;
+    static const int defaultTileBudget = 32 << 20;
+    // the image is cut into this many bands per thread, so that a thread
+    // that is done early takes another band
+    static const int bandsPerThread = 4;
+    static const int minBandHeight = 16;
+    // more changed squares than this are not worth painting one by one
+    static const int maxChangedRects = 256;
+    static const int densityRange = 12;
+    static const int colorMapSize = 256;
+};
+
+#endif // QT_GUI_LIB
+
+#endif // RASTERIZER_H
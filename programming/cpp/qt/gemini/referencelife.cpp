@@ -0,0 +1,148 @@
+/* KPCC
+ * Class ReferenceLife is a plain cell-by-cell simulator of Conway's Life on
+ * an unbounded field
+ * File: referencelife.cpp
+ */
+
+#include <algorithm>
+
+#include "referencelife.h"
+
+using namespace std;
+
+ReferenceLife::ReferenceLife()
+{
+    left = 0;
+    top = 0;
+    width = 0;
+    height = 0;
+    generationCount = 0;
+}
+
+void ReferenceLife::cover(int l, int t, int r, int b)
+{
+    if (width > 0 && height > 0)
+    {
+        l = min(l, left);
+        t = min(t, top);
+        r = max(r, left + width - 1);
+        b = max(b, top + height - 1);
+    }
+    QVector<char> covered((r - l + 1) * (b - t + 1), 0);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            covered[(top + y - t) * (r - l + 1) + left + x - l] =
+                    cells[y * width + x];
+        }
+    }
+    left = l;
+    top = t;
+    width = r - l + 1;
+    height = b - t + 1;
+    cells = covered;
+}
+
+void ReferenceLife::trim()
+{
+    QVector<QPoint> alive = livingCells();
+    width = 0;
+    height = 0;
+    cells.clear();
+    foreach (const QPoint &cell, alive)
+    {
+        setAlive(cell.x(), cell.y(), true);
+    }
+}
+
+bool ReferenceLife::isAlive(int x, int y) const
+{
+    if (x < left || x >= left + width || y < top || y >= top + height)
+    {
+        return false;
+    }
+    return cells[(y - top) * width + x - left] != 0;
+}
+
+void ReferenceLife::setAlive(int x, int y, bool isAlive)
+{
+    if (x < left || x >= left + width || y < top || y >= top + height)
+    {
+        if (!isAlive)
+        {
+            return;
+        }
+        cover(x, y, x, y);
+    }
+    cells[(y - top) * width + x - left] = isAlive ? 1 : 0;
+}
+
+void ReferenceLife::update()
+{
+    generationCount++;
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+    // the living cells of the next generation are at most one cell away
+    // from the current ones
+    int l = left - 1;
+    int t = top - 1;
+    int w = width + 2;
+    int h = height + 2;
+    QVector<char> next(w * h, 0);
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            int neighbours = 0;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if ((dx != 0 || dy != 0) &&
+                        isAlive(l + x + dx, t + y + dy))
+                    {
+                        neighbours++;
+                    }
+                }
+            }
+            bool alive = isAlive(l + x, t + y);
+            next[y * w + x] = neighbours == 3 ||
+                              (alive && neighbours == 2) ? 1 : 0;
+        }
+    }
+    left = l;
+    top = t;
+    width = w;
+    height = h;
+    cells = next;
+    trim();
+}
+
+long long ReferenceLife::getGeneration() const
+{
+    return generationCount;
+}
+
+long ReferenceLife::getPopulation() const
+{
+    return count(cells.begin(), cells.end(), 1);
+}
+
+QVector<QPoint> ReferenceLife::livingCells() const
+{
+    QVector<QPoint> alive;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (cells[y * width + x] != 0)
+            {
+                alive.push_back(QPoint(left + x, top + y));
+            }
+        }
+    }
+    return alive;
+}
@@ -0,0 +1,47 @@
+/* KPCC
+ * Class ReferenceLife is a plain cell-by-cell simulator of Conway's Life on
+ * an unbounded field. It is slow, but simple enough to be obviously right,
+ * so Grid is checked against it
+ * File: referencelife.h
+ */
+
+#ifndef REFERENCELIFE_H
+#define REFERENCELIFE_H
+
+#include <QPoint>
+#include <QVector>
+
+class ReferenceLife
+{
+private:
+    // the cells are kept in a dense array that covers the living cells;
+    // (left, top) is the coordinate of its first cell
+    int left;
+    int top;
+    int width;
+    int height;
+    QVector<char> cells; // row by row
+    long long generationCount;
+
+    // grows the array so that it covers the given rectangle too
+    void cover(int l, int t, int r, int b);
+    // shrinks the array to the bounding box of the living cells
+    void trim();
+public:
+    ReferenceLife();
+
+    // (x, y) is the same as (widthIndex, heightIndex) of Grid
+    bool isAlive(int x, int y) const;
+    void setAlive(int x, int y, bool isAlive);
+
+    // calculates the next generation
+    void update();
+
+    long long getGeneration() const;
+    long getPopulation() const;
+
+    // the living cells, row by row
+    QVector<QPoint> livingCells() const;
+};
+
+#endif // REFERENCELIFE_H
@@ -0,0 +1,245 @@
+/* KPCC
+ * RleReader decodes an RLE file into runs for a TreeBuilder
+ * File: rlereader.cpp
+ */
+
+#include <algorithm>
+#include <QFile>
+#include <QList>
+
+#include "rlereader.h"
+
+// cells further than that do not fit into the field
+static const long long maxCoordinate = 1LL << 30;
+
+RleReader::RleReader(TreeBuilder &builder, FileProgress *progress)
+    : builder(builder), progress(progress)
+{
+    state = LineStart;
+    width = -1;
+    height = -1;
+    level = 3;
+    originX = 0;
+    originY = 0;
+    x = 0;
+    y = 0;
+    count = 0;
+}
+
+int RleReader::getLevel() const
+{
+    return level;
+}
+
+int RleReader::getWidth() const
+{
+    return width;
+}
+
+int RleReader::getHeight() const
+{
+    return height;
+}
+
+/**
+*   "x = 36, y = 9, rule = B3/S23": the size is used to put the pattern in
+*   the centre of the tree, and other rules than Life are refused. A
+*   bounded grid after the rule, as in "B3/S23:P10,10", is left out: the
+*   pattern is run on the unbounded field.
+*/
+bool RleReader::parseHeader()
+{
+    // the grid has commas of its own, so it is cut off before the split
+    QByteArray header = headerLine;
+    int colon = header.indexOf(':');
+    if (colon >= 0)
+    {
+        header = header.left(colon);
+    }
+    QList<QByteArray> items = header.split(',');
+    foreach (const QByteArray &item, items)
+    {
+        int equals = item.indexOf('=');
+        if (equals < 0)
+        {
+            return false;
+        }
+        QByteArray key = item.left(equals).trimmed().toLower();
+        QByteArray value = item.mid(equals + 1).trimmed();
+        bool ok = true;
+        if (key == "x")
+        {
+            width = value.toInt(&ok);
+        }
+        if (key == "y")
+        {
+            height = value.toInt(&ok);
+        }
+        if (key == "rule")
+        {
+            QByteArray rule = value.toUpper();
+            ok = rule == "B3/S23" || rule == "23/3";
+        }
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    if (width < 0 || height < 0 || width >= maxCoordinate ||
+        height >= maxCoordinate)
+    {
+        return false;
+    }
+    int size = max(width, height);
+    level = 3;
+    while ((1LL << level) < 2LL * size)
+    {
+        level++;
+    }
+    originX = (1 << (level - 1)) - width / 2;
+    originY = (1 << (level - 1)) - height / 2;
+    return true;
+}
+
+bool RleReader::feed(const char *data, qint64 size)
+{
+    for (qint64 i = 0; i < size && state != Done; i++)
+    {
+        char c = data[i];
+        switch (state)
+        {
+        case LineStart:
+            if (c == '#')
+            {
+                state = Comment;
+            }
+            else
+            {
+                if (c == 'x' || c == 'X')
+                {
+                    state = Header;
+                    headerLine = QByteArray(1, c);
+                }
+                else
+                {
+                    if (c != '\n' && c != '\r' && c != ' ' && c != '\t')
+                    {
+                        state = Data;
+                        i--; // the character is data
+                    }
+                }
+            }
+            break;
+        case Comment:
+            if (c == '\n')
+            {
+                state = LineStart;
+            }
+            break;
+        case Header:
+            if (c == '\n' || c == '\r')
+            {
+                if (!parseHeader())
+                {
+                    return false;
+                }
+                state = LineStart;
+            }
+            else
+            {
+                headerLine += c;
+            }
+            break;
+        case Data:
+            if ('0' <= c && c <= '9')
+            {
+                count = 10 * count + (c - '0');
+                if (count >= maxCoordinate)
+                {
+                    return false;
+                }
+                break;
+            }
+            switch (c)
+            {
+            case 'b':
+            case '.':
+                x += max(count, 1LL);
+                break;
+            case 'o':
+                if (x + max(count, 1LL) > maxCoordinate ||
+                    !builder.addRun(originX + x, originY + y,
+                                    max(count, 1LL)))
+                {
+                    return false;
+                }
+                x += max(count, 1LL);
+                break;
+            case '$':
+                y += max(count, 1LL);
+                x = 0;
+                break;
+            case '!':
+                state = Done;
+                break;
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                continue; // a number may go on after a line break
+            default:
+                return false;
+            }
+            count = 0;
+            if (x >= maxCoordinate || y >= maxCoordinate)
+            {
+                return false;
+            }
+            break;
+        case Done:
+            break;
+        }
+    }
+    return true;
+}
+
+bool RleReader::read(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    bool success = true;
+    qint64 fileSize = file.size();
+    uchar *data = fileSize > 0 ? file.map(0, fileSize) : nullptr;
+    if (data != nullptr)
+    {
+        for (qint64 i = 0; success && i < fileSize; i += chunkSize)
+        {
+            success = feed((const char *)data + i,
+                           qMin(fileSize - i, (qint64)chunkSize)) &&
+                      (progress == nullptr ||
+                       progress->report(i + chunkSize, fileSize));
+        }
+        file.unmap(data);
+    }
+    else
+    {
+        // resources and some devices can not be mapped
+        QByteArray chunk(chunkSize, 0);
+        qint64 size;
+        qint64 read = 0;
+        while (success && (size = file.read(chunk.data(), chunk.size())) > 0)
+        {
+            read += size;
+            success = feed(chunk.constData(), size) &&
+                      (progress == nullptr || progress->report(read, fileSize));
+        }
+    }
+    if (success && state == Header)
+    {
+        success = parseHeader(); // the file ends with the header
+    }
+    return success;
+}
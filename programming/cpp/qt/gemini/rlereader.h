@@ -0,0 +1,65 @@
+/* KPCC
+ * RleReader decodes an RLE file straight from memory (the file is mapped
+ * if possible, read in chunks otherwise) into runs for a TreeBuilder,
+ * so reading takes little more memory than the tree itself
+ * File: rlereader.h
+ */
+
+#ifndef RLEREADER_H
+#define RLEREADER_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "fileprogress.h"
+#include "treebuilder.h"
+
+class RleReader
+{
+private:
+    enum State
+    {
+        LineStart, // before the data, at the start of a line
+        Comment,   // in a "#" line
+        Header,    // in the "x = ..., y = ..., rule = ..." line
+        Data,
+        Done       // after "!"
+    };
+
+    // a mapped file is fed in pieces this big, reporting after each
+    static const qint64 chunkSize = 1 << 20;
+
+    TreeBuilder &builder;
+    FileProgress *progress; // may be nullptr
+    State state;
+    QByteArray headerLine;
+    int width;     // from the header, -1 if there is none
+    int height;
+    int level;     // of the tree, so that the pattern is in its centre
+    int originX;   // cell (x, y) of the file is added at
+    int originY;   // (originX + x, originY + y)
+    long long x;   // current position
+    long long y;
+    long long count; // the number before a tag, 0 if none
+
+    bool parseHeader();
+    bool feed(const char *data, qint64 size);
+
+public:
+    // the cells will be added to "builder"; the bytes read are reported
+    // to "progress", if given
+    explicit RleReader(TreeBuilder &builder, FileProgress *progress = nullptr);
+
+    // false if the file can not be read, is not valid RLE, or its rule is
+    // not B3/S23, or if reading was cancelled
+    bool read(const QString &fileName);
+
+    // the level to finish the builder with
+    int getLevel() const;
+
+    // the size from the header, -1 if there was no header
+    int getWidth() const;
+    int getHeight() const;
+};
+
+#endif // RLEREADER_H
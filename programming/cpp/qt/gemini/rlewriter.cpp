@@ -0,0 +1,148 @@
+/* KPCC
+ * RleWriter encodes a TreeNode as RLE row by row
+ * File: rlewriter.cpp
+ */
+
+#include <algorithm>
+
+#include "rlewriter.h"
+
+RleWriter::RleWriter(QTextStream &stream, FileProgress *progress)
+    : stream(stream), progress(progress)
+{
+}
+
+// the first row of "node" from "row" on (counted from its top) that has
+// living cells; -1 if there is none
+int RleWriter::nextRow(const shared_ptr<TreeNode> &node, int row)
+{
+    row = max(row, 0);
+    if (node->getPopulation() == 0 || row >= (1 << node->getLevel()))
+    {
+        return -1;
+    }
+    if (node->getLevel() == 0)
+    {
+        return 0;
+    }
+    int half = 1 << (node->getLevel() - 1);
+    if (row < half)
+    {
+        int west = nextRow(node->getnw(), row);
+        int east = nextRow(node->getne(), row);
+        if (west >= 0 || east >= 0)
+        {
+            return west < 0 ? east : (east < 0 ? west : min(west, east));
+        }
+        row = half;
+    }
+    int west = nextRow(node->getsw(), row - half);
+    int east = nextRow(node->getse(), row - half);
+    if (west < 0 && east < 0)
+    {
+        return -1;
+    }
+    return half + (west < 0 ? east : (east < 0 ? west : min(west, east)));
+}
+
+// appends the living cells of row "row" of "node", whose left column is
+// "x", to "runs", from left to right
+void RleWriter::collectRuns(const shared_ptr<TreeNode> &node,
+                            int x,
+                            int row,
+                            QVector<Run> &runs)
+{
+    if (node->getPopulation() == 0)
+    {
+        return;
+    }
+    int size = 1 << node->getLevel();
+    // a full node is one run, whatever its size
+    if (node->getPopulation() == (long)size * size)
+    {
+        if (!runs.isEmpty() && runs.last().end == x)
+        {
+            runs.last().end = x + size;
+        }
+        else
+        {
+            runs.push_back({x, x + size});
+        }
+        return;
+    }
+    int half = size / 2;
+    if (row < half)
+    {
+        collectRuns(node->getnw(), x, row, runs);
+        collectRuns(node->getne(), x + half, row, runs);
+    }
+    else
+    {
+        collectRuns(node->getsw(), x, row - half, runs);
+        collectRuns(node->getse(), x + half, row - half, runs);
+    }
+}
+
+// writes "count" times "tag", wrapping the line if it gets too long
+void RleWriter::put(int count, char tag)
+{
+    QString item = count > 1 ? QString::number(count) + tag : QString(tag);
+    if (line.length() + item.length() > lineLength)
+    {
+        stream << line << "\n";
+        line.clear();
+    }
+    line += item;
+}
+
+/**
+*   Rows are found with nextRow, so runs of empty rows are skipped in one
+*   step, and within a row only the nodes crossing it are visited. Dead
+*   cells at the end of a row and empty rows at the end are not written.
+*/
+bool RleWriter::write(shared_ptr<TreeNode> node)
+{
+    line.clear();
+    if (node->getPopulation() == 0)
+    {
+        stream << "x = 0, y = 0, rule = B3/S23\n!\n";
+        return true;
+    }
+    int left = node->leftBoundary();
+    int top = node->topBoundary();
+    int height = node->bottomBoundary() - top + 1;
+    stream << "x = " << node->rightBoundary() - left + 1
+           << ", y = " << height
+           << ", rule = B3/S23\n";
+
+    QVector<Run> runs;
+    int previous = top;
+    for (int row = nextRow(node, top); row >= 0; row = nextRow(node, row + 1))
+    {
+        if (progress != nullptr && !progress->report(row - top, height))
+        {
+            return false;
+        }
+        if (row > previous)
+        {
+            put(row - previous, '$');
+        }
+        previous = row;
+        runs.clear();
+        collectRuns(node, 0, row, runs);
+        int x = left;
+        foreach (const Run &run, runs)
+        {
+            if (run.begin > x)
+            {
+                put(run.begin - x, 'b');
+            }
+            put(run.end - run.begin, 'o');
+            x = run.end;
+        }
+    }
+    put(1, '!');
+    stream << line << "\n";
+    line.clear();
+    return true;
+}
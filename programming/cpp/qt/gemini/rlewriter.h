@@ -0,0 +1,55 @@
+/* KPCC
+ * RleWriter encodes a TreeNode as RLE row by row, going down the tree only
+ * into nodes that have living cells, so that empty space costs nothing and
+ * no array of the cells is made
+ * File: rlewriter.h
+ */
+
+#ifndef RLEWRITER_H
+#define RLEWRITER_H
+
+#include <memory>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+
+#include "fileprogress.h"
+#include "treenode.h"
+
+using namespace std;
+
+class RleWriter
+{
+private:
+    // living cells [begin, end) of a row
+    struct Run
+    {
+        int begin;
+        int end;
+    };
+
+    QTextStream &stream;
+    FileProgress *progress; // may be nullptr
+    QString line; // the line being written
+
+    static int nextRow(const shared_ptr<TreeNode> &node, int row);
+    static void collectRuns(const shared_ptr<TreeNode> &node,
+                            int x,
+                            int row,
+                            QVector<Run> &runs);
+    void put(int count, char tag);
+
+public:
+    // lines longer than that are wrapped
+    static const int lineLength = 70;
+
+    // the rows written are reported to "progress", if given
+    explicit RleWriter(QTextStream &stream, FileProgress *progress = nullptr);
+
+    // writes the "x = , y = , rule = " header and the cells of the
+    // bounding box of "node"; false if writing was cancelled, and then
+    // the pattern is not finished
+    bool write(shared_ptr<TreeNode> node);
+};
+
+#endif // RLEWRITER_H
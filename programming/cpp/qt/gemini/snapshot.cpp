@@ -0,0 +1,350 @@
+/* KPCC
+ * Binary snapshot of a field
+ * File: snapshot.cpp
+ */
+
+#include <cstring>
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QVector>
+
+#include "snapshot.h"
+#include "treebuilder.h"
+
+static_assert(sizeof(Snapshot::Header) == 64, "the header is 64 bytes");
+static_assert(sizeof(Snapshot::Record) == 32, "a record is 32 bytes");
+
+static const char magic[8] = "GEMSNAP";
+static const char rule[16] = "B3/S23";
+
+// records are written and read that many at a time
+static const int recordsPerChunk = 4096;
+
+// writes the nodes of a tree in post order, numbering them as it goes
+class SnapshotWriter
+{
+private:
+    QFileDevice &file;
+    FileProgress *progress;
+    QVector<Snapshot::Record> buffer;
+    // the same node object is written once; structurally equal copies
+    // are not looked for, which would cost a deep comparison each
+    QHash<const TreeNode *, quint32> numbers;
+    bool ok;
+
+public:
+    quint64 count; // records written
+
+    SnapshotWriter(QFileDevice &file, FileProgress *progress)
+        : file(file), progress(progress)
+    {
+        ok = true;
+        count = 0;
+    }
+
+    void flush()
+    {
+        if (ok && !buffer.isEmpty())
+        {
+            qint64 size = buffer.size() * sizeof(Snapshot::Record);
+            ok = file.write((const char *)buffer.constData(), size) == size;
+        }
+        buffer.clear();
+        // the number of nodes is not known until they are written
+        if (progress != nullptr && !progress->report(count, 0))
+        {
+            ok = false;
+        }
+    }
+
+    bool isOk() const
+    {
+        return ok;
+    }
+
+    quint32 write(const shared_ptr<TreeNode> &node)
+    {
+        if (node->getPopulation() == 0)
+        {
+            return 0;
+        }
+        quint32 number = numbers.value(node.get(), 0);
+        if (number != 0)
+        {
+            return number;
+        }
+        Snapshot::Record record;
+        memset(&record, 0, sizeof(record));
+        record.population = node->getPopulation();
+        record.level = node->getLevel();
+        record.hash = node->hash();
+        if (node->getLevel() == 3)
+        {
+            for (int y = -4; y < 4; y++)
+            {
+                for (int x = -4; x < 4; x++)
+                {
+                    if (node->getBit(x, y) == 1)
+                    {
+                        record.cells |= 1ULL << (8 * (y + 4) + x + 4);
+                    }
+                }
+            }
+        }
+        else
+        {
+            record.children[0] = write(node->getnw());
+            record.children[1] = write(node->getne());
+            record.children[2] = write(node->getsw());
+            record.children[3] = write(node->getse());
+        }
+        buffer.push_back(record);
+        if (buffer.size() >= recordsPerChunk)
+        {
+            flush();
+        }
+        if (count == 0xFFFFFFFF)
+        {
+            ok = false; // the numbers are 32-bit
+            return 0;
+        }
+        number = ++count;
+        numbers[node.get()] = number;
+        return number;
+    }
+};
+
+// builds the nodes of the table one by one, checking every record
+class SnapshotReader
+{
+private:
+    TreeBuilder builder;
+    QVector<shared_ptr<TreeNode> > nodes; // by number, nodes[0] unused
+    bool hasHashes; // false for version 1, where they are not written
+
+public:
+    SnapshotReader()
+    {
+        nodes.push_back(nullptr);
+        hasHashes = true;
+    }
+
+    void setVersion(quint32 version)
+    {
+        hasHashes = version >= 2;
+    }
+
+    bool read(const Snapshot::Record &record)
+    {
+        if (record.level < 3 || record.level > 62)
+        {
+            return false;
+        }
+        shared_ptr<TreeNode> node;
+        if (record.level == 3)
+        {
+            node = builder.blockNode(record.cells);
+        }
+        else
+        {
+            shared_ptr<TreeNode> children[4];
+            for (int i = 0; i < 4; i++)
+            {
+                quint32 number = record.children[i];
+                if (number >= (quint32)nodes.size())
+                {
+                    return false; // children come before their parents
+                }
+                children[i] = number == 0 ?
+                                  builder.emptyNode(record.level - 1) :
+                                  nodes[number];
+                if (children[i]->getLevel() != (int)record.level - 1)
+                {
+                    return false;
+                }
+            }
+            node = make_shared<TreeNode>(children[0], children[1],
+                                         children[2], children[3]);
+        }
+        if ((quint64)node->getPopulation() != record.population ||
+            (hasHashes && node->hash() != record.hash))
+        {
+            return false;
+        }
+        nodes.push_back(node);
+        return true;
+    }
+
+    shared_ptr<TreeNode> root(int level)
+    {
+        return nodes.size() > 1 ? nodes.last() : builder.emptyNode(level);
+    }
+};
+
+bool Snapshot::isValid(const Header &header, qint64 fileSize)
+{
+    return memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+           header.version >= firstVersion && header.version <= version &&
+           header.byteOrder == byteOrderMark &&
+           memcmp(header.rule, rule, sizeof(rule)) == 0 &&
+           header.recordSize == sizeof(Record) &&
+           header.rootLevel >= 3 && header.rootLevel <= 62 &&
+           header.stepLog2 >= -1 && header.stepLog2 <= TreeNode::maxStepLog2 &&
+           header.nodeCount <= (quint64)(fileSize - sizeof(Header)) /
+                               sizeof(Record) &&
+           (qint64)(sizeof(Header) + header.nodeCount * sizeof(Record)) ==
+               fileSize;
+}
+
+QVector<quint32> Snapshot::computeHashes(const Record *records,
+                                         quint64 count)
+{
+    TreeBuilder builder;
+    QVector<quint32> hashes;
+    hashes.reserve(count);
+    for (quint64 i = 0; i < count; i++)
+    {
+        const Record &record = records[i];
+        if (record.level <= 3)
+        {
+            hashes.push_back(builder.blockNode(record.cells)->hash());
+            continue;
+        }
+        // as in TreeNode; an empty node hashes to 0
+        quint32 hash[4];
+        for (int j = 0; j < 4; j++)
+        {
+            quint32 number = record.children[j];
+            hash[j] = number != 0 && number <= i ? hashes[number - 1] : 0;
+        }
+        hashes.push_back(hash[0] + 11 * hash[1] + 101 * hash[2] +
+                         1007 * hash[3]);
+    }
+    return hashes;
+}
+
+/**
+*   The header is written first with no nodes and rewritten at the end,
+*   when their number is known; everything in between is appended.
+*/
+bool Snapshot::save(const QString &fileName,
+                    shared_ptr<TreeNode> root,
+                    long long generation,
+                    int stepLog2,
+                    FileProgress *progress)
+{
+    // the file is replaced only when it is written completely
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    while (root->getLevel() < 3)
+    {
+        root = root->expandUniverse();
+    }
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrder = byteOrderMark;
+    memcpy(header.rule, rule, sizeof(rule));
+    header.generation = generation;
+    header.stepLog2 = stepLog2;
+    header.recordSize = sizeof(Record);
+    header.rootLevel = root->getLevel();
+    if (file.write((const char *)&header, sizeof(header)) != sizeof(header))
+    {
+        return false;
+    }
+
+    SnapshotWriter writer(file, progress);
+    writer.write(root);
+    writer.flush();
+    header.nodeCount = writer.count;
+    return writer.isOk() && file.seek(0) &&
+           file.write((const char *)&header, sizeof(header)) ==
+               sizeof(header) &&
+           file.commit();
+}
+
+bool Snapshot::load(const QString &fileName,
+                    shared_ptr<TreeNode> &root,
+                    long long &generation,
+                    int &stepLog2,
+                    FileProgress *progress)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < (qint64)sizeof(Header))
+    {
+        return false;
+    }
+    SnapshotReader reader;
+    Header header;
+    uchar *data = file.map(0, file.size());
+    if (data != nullptr)
+    {
+        memcpy(&header, data, sizeof(header));
+        if (!isValid(header, file.size()))
+        {
+            file.unmap(data);
+            return false;
+        }
+        reader.setVersion(header.version);
+        const Record *records = (const Record *)(data + sizeof(Header));
+        for (quint64 i = 0; i < header.nodeCount; i++)
+        {
+            if (!reader.read(records[i]) ||
+                (i % recordsPerChunk == 0 && progress != nullptr &&
+                 !progress->report(i, header.nodeCount)))
+            {
+                file.unmap(data);
+                return false;
+            }
+        }
+        file.unmap(data);
+    }
+    else
+    {
+        // resources and some devices can not be mapped
+        if (file.read((char *)&header, sizeof(header)) != sizeof(header) ||
+            !isValid(header, file.size()))
+        {
+            return false;
+        }
+        reader.setVersion(header.version);
+        QVector<Record> chunk(recordsPerChunk);
+        for (quint64 i = 0; i < header.nodeCount; )
+        {
+            qint64 count = qMin<quint64>(header.nodeCount - i,
+                                         recordsPerChunk);
+            qint64 size = count * sizeof(Record);
+            if (file.read((char *)chunk.data(), size) != size)
+            {
+                return false;
+            }
+            for (int j = 0; j < count; j++)
+            {
+                if (!reader.read(chunk[j]))
+                {
+                    return false;
+                }
+            }
+            i += count;
+            if (progress != nullptr && !progress->report(i, header.nodeCount))
+            {
+                return false;
+            }
+        }
+    }
+    shared_ptr<TreeNode> node = reader.root(header.rootLevel);
+    if (node->getLevel() != (int)header.rootLevel)
+    {
+        return false;
+    }
+    root = node;
+    generation = header.generation;
+    stepLog2 = header.stepLog2;
+    return true;
+}
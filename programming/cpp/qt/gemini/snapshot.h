@@ -0,0 +1,97 @@
+/* KPCC
+ * Binary snapshot of a field: a header followed by a table of fixed-size
+ * node records, children before their parents and the root last, so the
+ * file is written in one sequential pass and, when mapped, the table is
+ * read in place with no parsing
+ * File: snapshot.h
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <memory>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include "fileprogress.h"
+#include "treenode.h"
+
+using namespace std;
+
+class Snapshot
+{
+public:
+    static const quint32 version = 2;
+    // the oldest version that is still read; version 1 records have no
+    // hash, see Record
+    static const quint32 firstVersion = 1;
+    // written as it is in memory, so that a file from a machine of the
+    // other byte order is recognised
+    static const quint32 byteOrderMark = 0x01020304;
+
+    // the first 64 bytes of the file
+    struct Header
+    {
+        char magic[8];       // "GEMSNAP" and a zero
+        quint32 version;
+        quint32 byteOrder;   // byteOrderMark
+        char rule[16];       // "B3/S23", padded with zeros
+        qint64 generation;
+        qint32 stepLog2;     // the step in progress when saved, -1 if none
+        quint32 recordSize;  // sizeof(Record)
+        quint64 nodeCount;   // records after the header
+        quint32 rootLevel;
+        quint32 reserved;
+    };
+
+    // Node i of the table (from 1) is the i-th record. Children are
+    // numbers of earlier records, 0 meaning an empty node of level - 1;
+    // nodes of level 3 keep their cells instead, bit 8 * row + column.
+    // The population and the hash let a node be used before its
+    // children are read; in version 1 the hash is 0 and is computed when
+    // the file is read. An empty root is not written: then the table is
+    // empty
+    struct Record
+    {
+        quint64 population;
+        union
+        {
+            quint32 children[4]; // nw, ne, sw, se
+            quint64 cells;
+        };
+        quint32 level;
+        quint32 hash;        // TreeNode::hash()
+    };
+
+    // writes "root" (the field), its generation and the step in progress
+    // (-1 if none); false if the file could not be written or writing was
+    // cancelled, and then the file is not changed. The nodes written are
+    // reported to "progress", if given
+    static bool save(const QString &fileName,
+                     shared_ptr<TreeNode> root,
+                     long long generation,
+                     int stepLog2,
+                     FileProgress *progress = nullptr);
+
+    // false if the file can not be read or is not a valid snapshot, or if
+    // reading was cancelled; then the arguments are not changed. The
+    // records read are reported to "progress", if given
+    static bool load(const QString &fileName,
+                     shared_ptr<TreeNode> &root,
+                     long long &generation,
+                     int &stepLog2,
+                     FileProgress *progress = nullptr);
+
+    // true if "header" is one of a snapshot this version can read, of a
+    // file of "fileSize" bytes
+    static bool isValid(const Header &header, qint64 fileSize);
+
+    // the hashes of the "count" records of a version 1 file, which has
+    // none, computed in one pass over the table; a child number that is
+    // not of an earlier record counts as an empty node
+    static QVector<quint32> computeHashes(const Record *records,
+                                          quint64 count);
+};
+
+#endif // SNAPSHOT_H
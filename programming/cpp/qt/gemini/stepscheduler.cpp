@@ -0,0 +1,185 @@
+/* KPCC
+ * StepScheduler decides how many generations and in what steps are
+ * computed every frame, so that the field runs at a given speed
+ * File: stepscheduler.cpp
+ */
+
+#include <algorithm>
+
+#include "stepscheduler.h"
+#include "tracer.h"
+
+StepScheduler::StepScheduler()
+{
+    targetRate = 10;
+    frameBudget = 50;
+    stepLog2 = 0;
+    pendingStepLog2 = 0;
+    pendingTime = 0;
+    for (int i = 0; i <= TreeNode::maxStepLog2; i++)
+    {
+        stepTime[i] = 0;
+    }
+    reset();
+}
+
+void StepScheduler::setTargetRate(double generationsPerSecond)
+{
+    targetRate = max(generationsPerSecond, 0.0);
+    owed = 0;
+}
+
+double StepScheduler::getTargetRate() const
+{
+    return targetRate;
+}
+
+void StepScheduler::setFrameBudget(int milliseconds)
+{
+    frameBudget = max(milliseconds, 1);
+}
+
+int StepScheduler::getFrameBudget() const
+{
+    return frameBudget;
+}
+
+int StepScheduler::getStepLog2() const
+{
+    return stepLog2;
+}
+
+double StepScheduler::getAchievedRate() const
+{
+    return achievedRate;
+}
+
+void StepScheduler::reset()
+{
+    owed = 0;
+    frameClock.invalidate();
+    rateClock.invalidate();
+    rateGenerations = 0;
+    achievedRate = 0;
+}
+
+double StepScheduler::estimateStepTime(int k) const
+{
+    // HashLife makes big steps about as fast as small ones, so a step
+    // that was never measured is assumed to be as expensive as the
+    // nearest smaller one
+    for (int i = k; i >= 0; i--)
+    {
+        if (stepTime[i] != 0)
+        {
+            return stepTime[i];
+        }
+    }
+    return 0;
+}
+
+int StepScheduler::chooseStep(double generations) const
+{
+    double budget = frameBudget * 1e6;
+    int k = 0;
+    while (k < TreeNode::maxStepLog2)
+    {
+        double steps = generations / (1LL << k);
+        if (steps <= maxStepsPerFrame &&
+            steps * estimateStepTime(k) <= budget)
+        {
+            break;
+        }
+        k++;
+    }
+    return k;
+}
+
+long long StepScheduler::advance(Grid &grid)
+{
+    TRACE_ZONE("StepScheduler::advance");
+    qint64 sincePreviousFrame = frameClock.isValid() ?
+                                    frameClock.nsecsElapsed() : 0;
+    frameClock.start();
+    if (!rateClock.isValid())
+    {
+        rateClock.start();
+    }
+
+    QElapsedTimer budgetClock;
+    budgetClock.start();
+    qint64 budget = frameBudget * 1000000LL;
+
+    if (targetRate > 0)
+    {
+        owed += targetRate * sincePreviousFrame / 1e9;
+        // if the computer can not keep up, we fall behind instead of
+        // trying to catch up forever
+        owed = min(owed, max(targetRate, 1.0));
+        stepLog2 = chooseStep(owed);
+    }
+    else
+    {
+        // as fast as possible: the step grows while maxStepsPerFrame of
+        // them fit into the budget, and shrinks when one step does not;
+        // one power of two per frame, as a bigger step costs more
+        double estimate = estimateStepTime(stepLog2);
+        if (estimate * maxStepsPerFrame < budget &&
+            stepLog2 < TreeNode::maxStepLog2)
+        {
+            stepLog2++;
+        }
+        else
+        {
+            if (estimate > budget && stepLog2 > 0)
+            {
+                stepLog2--;
+            }
+        }
+    }
+
+    long long done = 0;
+    qint64 left;
+    while ((left = budget - budgetClock.nsecsElapsed()) > 0)
+    {
+        if (!grid.isStepping())
+        {
+            if (targetRate > 0 && owed < (1LL << stepLog2))
+            {
+                break;
+            }
+            if (!grid.beginStep(stepLog2))
+            {
+                break; // the field can not grow any more
+            }
+            pendingStepLog2 = stepLog2;
+            pendingTime = 0;
+            if (targetRate > 0)
+            {
+                owed -= 1LL << stepLog2;
+            }
+        }
+        QElapsedTimer stepClock;
+        stepClock.start();
+        bool finished = grid.continueStep(left);
+        pendingTime += stepClock.nsecsElapsed();
+        if (!finished)
+        {
+            break;
+        }
+        stepTime[pendingStepLog2] = stepTime[pendingStepLog2] == 0 ?
+                                    pendingTime :
+                                    0.75 * stepTime[pendingStepLog2] +
+                                    0.25 * pendingTime;
+        done += 1LL << pendingStepLog2;
+    }
+
+    rateGenerations += done;
+    if (rateClock.elapsed() >= 500)
+    {
+        achievedRate = rateGenerations * 1e9 / rateClock.nsecsElapsed();
+        rateGenerations = 0;
+        rateClock.start();
+    }
+    return done;
+}
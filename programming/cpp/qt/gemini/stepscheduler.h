@@ -0,0 +1,70 @@
+/* KPCC
+ * StepScheduler decides how many generations and in what steps are
+ * computed every frame, so that the field runs at a given speed
+ * File: stepscheduler.h
+ */
+
+#ifndef STEPSCHEDULER_H
+#define STEPSCHEDULER_H
+
+#include <QElapsedTimer>
+
+#include "grid.h"
+#include "treenode.h"
+
+class StepScheduler
+{
+private:
+    double targetRate;  // generations per second; 0 means "as fast as the
+                        // frame budget allows"
+    int frameBudget;    // milliseconds a frame may spend on computing
+    int stepLog2;       // the last step was 2^stepLog2 generations
+    double owed;        // generations that are due, but not computed yet
+    int pendingStepLog2; // the step the grid is in the middle of
+    double pendingTime;  // nanoseconds spent on it so far
+
+    // moving average of the time (in nanoseconds) of a step of 2^i
+    // generations; 0 if such a step was never made
+    double stepTime[TreeNode::maxStepLog2 + 1];
+
+    QElapsedTimer frameClock; // time since the previous frame
+    QElapsedTimer rateClock;  // time since achievedRate was last calculated
+    long long rateGenerations; // generations computed since then
+    double achievedRate;      // generations per second actually computed
+
+    // we never make more steps than this in a frame; if more are needed,
+    // a bigger step is taken instead
+    static const int maxStepsPerFrame = 64;
+
+    // expected time of a step of 2^k generations
+    double estimateStepTime(int k) const;
+
+    // the smallest step that lets "generations" be computed within the
+    // frame budget and in no more than maxStepsPerFrame steps
+    int chooseStep(double generations) const;
+
+public:
+    StepScheduler();
+
+    void setTargetRate(double generationsPerSecond);
+    double getTargetRate() const;
+
+    void setFrameBudget(int milliseconds);
+    int getFrameBudget() const;
+
+    int getStepLog2() const;
+    double getAchievedRate() const;
+
+    // forgets the generations that are due; call it when the field is
+    // stopped, so that it does not try to catch up when started again
+    void reset();
+
+    // computes the generations due since the previous call, spending
+    // no more than the frame budget on it; a step that does not fit into
+    // the budget is left in the grid unfinished and continued next time
+    // returns the number of generations computed. It stops when the
+    // field can grow no more (see Grid::isAtLimit)
+    long long advance(Grid &grid);
+};
+
+#endif // STEPSCHEDULER_H
@@ -0,0 +1,174 @@
+/* KPCC
+ * Tracer records trace zones into per-thread ring buffers and exports them
+ * as a Chrome trace
+ * File: tracer.cpp
+ */
+
+#include <algorithm>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QThread>
+
+#include "tracer.h"
+
+atomic<bool> Tracer::enabled(false);
+QMutex Tracer::buffersMutex;
+QVector<Tracer::Buffer *> Tracer::buffers;
+
+void Tracer::setEnabled(bool isEnabled)
+{
+    enabled.store(isEnabled, memory_order_relaxed);
+}
+
+qint64 Tracer::now()
+{
+    static QElapsedTimer clock;
+    static bool started = (clock.start(), true);
+    (void)started;
+    return clock.nsecsElapsed();
+}
+
+Tracer::Buffer *Tracer::threadBuffer()
+{
+    static thread_local Buffer *buffer = nullptr;
+    if (buffer == nullptr)
+    {
+        buffer = new Buffer;
+        buffer->head.store(0);
+        buffer->tail.store(0);
+        for (int i = 0; i < bufferSize; i++)
+        {
+            buffer->events[i].sequence.store(0, memory_order_relaxed);
+        }
+        QThread *thread = QThread::currentThread();
+        QMutexLocker locker(&buffersMutex);
+        buffer->threadId = buffers.size() + 1;
+        buffer->threadName = thread->objectName();
+        if (buffer->threadName.isEmpty())
+        {
+            bool isMain = QCoreApplication::instance() != nullptr &&
+                          QCoreApplication::instance()->thread() == thread;
+            buffer->threadName = isMain ?
+                        QString("main") :
+                        QString("thread %1").arg(buffer->threadId);
+        }
+        buffers.push_back(buffer);
+    }
+    return buffer;
+}
+
+void Tracer::record(const char *name, qint64 start, qint64 end)
+{
+    Buffer *buffer = threadBuffer();
+    quint64 head = buffer->head.load(memory_order_relaxed);
+    Event &event = buffer->events[head % bufferSize];
+    // the release stores keep the 0 before the fields, so a reader that
+    // sees a new field sees the 0 too
+    event.sequence.store(0, memory_order_relaxed);
+    event.name.store(name, memory_order_release);
+    event.start.store(start, memory_order_release);
+    event.end.store(end, memory_order_release);
+    event.sequence.store(head + 1, memory_order_release);
+    buffer->head.store(head + 1, memory_order_release);
+}
+
+void Tracer::clear()
+{
+    QMutexLocker locker(&buffersMutex);
+    foreach (Buffer *buffer, buffers)
+    {
+        buffer->tail.store(buffer->head.load(memory_order_acquire),
+                           memory_order_relaxed);
+    }
+}
+
+/**
+*   A seqlock read: the fields are copied between two reads of the
+*   sequence, and the copy counts only if both reads show event "index"
+*   written in full. The acquire loads keep the second read after the
+*   copy.
+*/
+bool Tracer::copyEvent(const Event &event, quint64 index, Copy &copy)
+{
+    if (event.sequence.load(memory_order_acquire) != index + 1)
+    {
+        return false;
+    }
+    copy.index = index;
+    copy.name = event.name.load(memory_order_acquire);
+    copy.start = event.start.load(memory_order_acquire);
+    copy.end = event.end.load(memory_order_acquire);
+    return event.sequence.load(memory_order_relaxed) == index + 1;
+}
+
+bool Tracer::exportChromeTrace(const QString &fileName)
+{
+    QJsonArray events;
+    {
+        QMutexLocker locker(&buffersMutex);
+        foreach (Buffer *buffer, buffers)
+        {
+            QJsonObject threadName;
+            threadName["name"] = QString("thread_name");
+            threadName["ph"] = QString("M");
+            threadName["pid"] = 1;
+            threadName["tid"] = buffer->threadId;
+            QJsonObject args;
+            args["name"] = buffer->threadName;
+            threadName["args"] = args;
+            events.append(threadName);
+
+            quint64 head = buffer->head.load(memory_order_acquire);
+            quint64 first = max(buffer->tail.load(memory_order_relaxed),
+                                head > (quint64)bufferSize ?
+                                    head - bufferSize : 0);
+            QVector<Copy> copied;
+            for (quint64 i = first; i < head; i++)
+            {
+                Copy copy;
+                if (copyEvent(buffer->events[i % bufferSize], i, copy))
+                {
+                    copied.push_back(copy);
+                }
+            }
+            // the owner could have overwritten the oldest events while
+            // they were copied, and may be writing the slot of event
+            // newHead - bufferSize right now
+            quint64 newHead = buffer->head.load(memory_order_acquire);
+            quint64 valid = newHead >= (quint64)bufferSize ?
+                        newHead - bufferSize + 1 : 0;
+            foreach (const Copy &e, copied)
+            {
+                if (e.index < valid)
+                {
+                    continue;
+                }
+                QJsonObject event;
+                event["name"] = QString(e.name);
+                event["ph"] = QString("X");
+                event["pid"] = 1;
+                event["tid"] = buffer->threadId;
+                // Chrome traces count in microseconds
+                event["ts"] = e.start / 1e3;
+                event["dur"] = (e.end - e.start) / 1e3;
+                events.append(event);
+            }
+        }
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = QString("ms");
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    return file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) >=
+           0;
+}
@@ -0,0 +1,121 @@
+/* KPCC
+ * Tracer records how long marked parts of the program (trace zones) take,
+ * into a ring buffer per thread, and exports the records as a Chrome trace
+ * (JSON that chrome://tracing or Perfetto open). While tracing is off, a
+ * zone costs one check of a flag
+ * File: tracer.h
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+using namespace std;
+
+class Tracer
+{
+public:
+    // the number of the latest zones kept per thread
+    static const int bufferSize = 1 << 16;
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // nanoseconds since the tracer was first used
+    static qint64 now();
+
+    // called by TraceZone; "name" must live until the trace is exported,
+    // so it is a string literal
+    static void record(const char *name, qint64 start, qint64 end);
+
+    // forgets everything recorded so far
+    static void clear();
+
+    // writes the zones recorded by all the threads into "fileName";
+    // returns false if the file could not be written
+    static bool exportChromeTrace(const QString &fileName);
+
+private:
+    // The fields are atomics, so that an event may be read while its
+    // thread overwrites it; "sequence" is the number of the event in the
+    // buffer plus one once it is written, and 0 while it is being written
+    struct Event
+    {
+        atomic<quint64> sequence;
+        atomic<const char *> name;
+        atomic<qint64> start;
+        atomic<qint64> end;
+    };
+
+    // Only its own thread writes into a buffer: it fills the event and
+    // then moves "head". Others read the events before "head" and drop
+    // those whose sequence changed while they were copied, so nobody waits
+    struct Buffer
+    {
+        Event events[bufferSize];
+        atomic<quint64> head;  // the number of events ever written
+        atomic<quint64> tail;  // events before this one are cleared
+        int threadId;
+        QString threadName;
+    };
+
+    // an event as read by exportChromeTrace
+    struct Copy
+    {
+        quint64 index;
+        const char *name;
+        qint64 start;
+        qint64 end;
+    };
+
+    // copies event "index" from its slot; returns false if the slot holds
+    // another event or was written while it was copied
+    static bool copyEvent(const Event &event, quint64 index, Copy &copy);
+
+    static atomic<bool> enabled;
+
+    // all the buffers ever created; they live as long as the program, so
+    // a thread may finish without losing its zones
+    static QMutex buffersMutex;
+    static QVector<Buffer *> buffers;
+
+    // the buffer of the calling thread, created when first needed
+    static Buffer *threadBuffer();
+};
+
+inline bool Tracer::isEnabled()
+{
+    return enabled.load(memory_order_relaxed);
+}
+
+// records the time from its construction to its destruction
+class TraceZone
+{
+private:
+    const char *name;
+    qint64 start; // -1 if tracing was off
+public:
+    explicit TraceZone(const char *name)
+        : name(name), start(Tracer::isEnabled() ? Tracer::now() : -1)
+    {
+    }
+
+    ~TraceZone()
+    {
+        if (start >= 0)
+        {
+            Tracer::record(name, start, Tracer::now());
+        }
+    }
+};
+
+#define TRACE_ZONE_CONCAT2(a, b) a##b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT2(a, b)
+// marks the rest of the enclosing block as a zone called "name"
+#define TRACE_ZONE(name) TraceZone TRACE_ZONE_CONCAT(traceZone, __LINE__)(name)
+
+#endif // TRACER_H
@@ -0,0 +1,245 @@
+/* KPCC
+ * TreeBuilder builds a TreeNode from runs of living cells given row by row
+ * File: treebuilder.cpp
+ */
+
+#include <algorithm>
+
+#include "treebuilder.h"
+
+TreeBuilder::TreeBuilder()
+{
+    band = 0;
+    cells[0] = make_shared<TreeNode>(false);
+    cells[1] = make_shared<TreeNode>(true);
+    // bit 0 - nw, 1 - ne, 2 - sw, 3 - se
+    for (int i = 0; i < 16; i++)
+    {
+        level1Nodes[i] = make_shared<TreeNode>(cells[i & 1],
+                                               cells[(i >> 1) & 1],
+                                               cells[(i >> 2) & 1],
+                                               cells[(i >> 3) & 1]);
+    }
+    level2Nodes.resize(1 << 16);
+    emptyNodes.push_back(cells[0]);
+    emptyNodes.push_back(level1Nodes[0]);
+}
+
+shared_ptr<TreeNode> TreeBuilder::emptyNode(int level)
+{
+    while (emptyNodes.size() <= level)
+    {
+        shared_ptr<TreeNode> e = emptyNodes.last();
+        emptyNodes.push_back(make_shared<TreeNode>(e, e, e, e));
+    }
+    return emptyNodes[level];
+}
+
+// "bits" is a 4x4 block, bit 4 * row + column
+shared_ptr<TreeNode> TreeBuilder::level2Node(int bits)
+{
+    shared_ptr<TreeNode> &node = level2Nodes[bits];
+    if (node == nullptr)
+    {
+        int quarter[4] = {0, 0, 0, 0};
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                if ((bits >> (4 * row + column)) & 1)
+                {
+                    quarter[(row / 2) * 2 + column / 2] |=
+                            1 << ((row % 2) * 2 + column % 2);
+                }
+            }
+        }
+        node = make_shared<TreeNode>(level1Nodes[quarter[0]],
+                                     level1Nodes[quarter[1]],
+                                     level1Nodes[quarter[2]],
+                                     level1Nodes[quarter[3]]);
+    }
+    return node;
+}
+
+// "bits" is an 8x8 block, bit 8 * row + column
+shared_ptr<TreeNode> TreeBuilder::blockNode(quint64 bits)
+{
+    int quarter[4] = {0, 0, 0, 0};
+    for (int row = 0; row < 8; row++)
+    {
+        int line = (bits >> (8 * row)) & 0xFF;
+        int q = (row / 4) * 2;
+        quarter[q] |= (line & 0xF) << (4 * (row % 4));
+        quarter[q + 1] |= (line >> 4) << (4 * (row % 4));
+    }
+    return make_shared<TreeNode>(level2Node(quarter[0]),
+                                 level2Node(quarter[1]),
+                                 level2Node(quarter[2]),
+                                 level2Node(quarter[3]));
+}
+
+bool TreeBuilder::addRun(int x, int y, int length)
+{
+    if (length <= 0)
+    {
+        return true;
+    }
+    if (y / 8 < band)
+    {
+        return false;
+    }
+    if (y / 8 != band)
+    {
+        flushBand();
+        band = y / 8;
+    }
+    int shift = 8 * (y % 8);
+    long long end = (long long)x + length; // the first cell after the run
+    for (long long start = x; start < end; )
+    {
+        int column = start / 8;
+        int from = start % 8;
+        int to = (int)min<long long>(end - (long long)column * 8, 8);
+        quint64 row = ((1u << to) - 1) & ~((1u << from) - 1);
+        blocks[column] |= row << shift;
+        start = (long long)column * 8 + to;
+    }
+    return true;
+}
+
+void TreeBuilder::flushBand()
+{
+    if (blocks.isEmpty())
+    {
+        return;
+    }
+    Strip strip;
+    for (QMap<int, quint64>::const_iterator i = blocks.constBegin();
+         i != blocks.constEnd(); ++i)
+    {
+        strip[i.key()] = blockNode(i.value());
+    }
+    blocks.clear();
+    addStrip(3, band, strip);
+}
+
+TreeBuilder::Strip TreeBuilder::join(int level,
+                                     const Strip &upper,
+                                     const Strip &lower)
+{
+    QVector<int> columns;
+    foreach (int column, upper.keys() + lower.keys())
+    {
+        columns.push_back(column / 2);
+    }
+    sort(columns.begin(), columns.end());
+    columns.erase(unique(columns.begin(), columns.end()), columns.end());
+
+    shared_ptr<TreeNode> empty = emptyNode(level);
+    Strip joined;
+    foreach (int c, columns)
+    {
+        joined[c] = make_shared<TreeNode>(upper.value(2 * c, empty),
+                                          upper.value(2 * c + 1, empty),
+                                          lower.value(2 * c, empty),
+                                          lower.value(2 * c + 1, empty));
+    }
+    return joined;
+}
+
+/**
+*   Strips of a level come in the order of their indices. Strips 2i and
+*   2i + 1 make strip i of the next level; if one of them never comes,
+*   it is empty.
+*/
+void TreeBuilder::addStrip(int level, int index, const Strip &strip)
+{
+    while (pending.size() <= level + 1)
+    {
+        Pending nothing;
+        nothing.present = false;
+        nothing.index = 0;
+        pending.push_back(nothing);
+    }
+    Pending &p = pending[level];
+    if (p.present && p.index / 2 != index / 2)
+    {
+        // the strip below p was empty
+        p.present = false;
+        Strip upper = p.strip;
+        p.strip.clear();
+        addStrip(level + 1, p.index / 2, join(level, upper, Strip()));
+    }
+    Pending &q = pending[level];
+    if (index % 2 == 0)
+    {
+        q.present = true;
+        q.index = index;
+        q.strip = strip;
+        return;
+    }
+    Strip upper = q.present ? q.strip : Strip();
+    q.present = false;
+    q.strip.clear();
+    addStrip(level + 1, index / 2, join(level, upper, strip));
+}
+
+shared_ptr<TreeNode> TreeBuilder::finish(int minLevel)
+{
+    flushBand();
+    minLevel = max(minLevel, 3);
+    shared_ptr<TreeNode> root;
+    for (int level = 3; root == nullptr; level++)
+    {
+        bool higher = false;
+        for (int i = level + 1; i < pending.size(); i++)
+        {
+            higher = higher || pending[i].present;
+        }
+        Pending p;
+        p.present = false;
+        if (level < pending.size())
+        {
+            p = pending[level];
+            pending[level].present = false;
+            pending[level].strip.clear();
+        }
+        if (!p.present)
+        {
+            if (!higher && level >= minLevel)
+            {
+                root = emptyNode(level); // nothing was added
+            }
+            continue;
+        }
+        bool single = p.strip.isEmpty() ||
+                      (p.strip.size() == 1 && p.strip.firstKey() == 0);
+        if (p.index == 0 && single && !higher && level >= minLevel)
+        {
+            root = p.strip.value(0, emptyNode(level));
+            continue;
+        }
+        addStrip(level + 1, p.index / 2, join(level, p.strip, Strip()));
+    }
+    pending.clear();
+    band = 0;
+    return root;
+}
+
+shared_ptr<TreeNode> TreeBuilder::unite(shared_ptr<TreeNode> a,
+                                        shared_ptr<TreeNode> b)
+{
+    if (a->getPopulation() == 0)
+    {
+        return b;
+    }
+    // a leaf here is alive
+    if (b->getPopulation() == 0 || a.get() == b.get() || a->getLevel() == 0)
+    {
+        return a;
+    }
+    return make_shared<TreeNode>(unite(a->getnw(), b->getnw()),
+                                 unite(a->getne(), b->getne()),
+                                 unite(a->getsw(), b->getsw()),
+                                 unite(a->getse(), b->getse()));
+}
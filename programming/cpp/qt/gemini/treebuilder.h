@@ -0,0 +1,74 @@
+/* KPCC
+ * TreeBuilder builds a TreeNode from runs of living cells given row by
+ * row, without setting the cells one by one: the rows of a band 8 cells
+ * high are collected as bit masks of 8x8 blocks, and finished bands are
+ * joined into bigger nodes pairwise, like a binary counter. Only one band
+ * and one strip of nodes per level are kept besides the tree
+ * File: treebuilder.h
+ */
+
+#ifndef TREEBUILDER_H
+#define TREEBUILDER_H
+
+#include <memory>
+#include <QMap>
+#include <QVector>
+
+#include "treenode.h"
+
+using namespace std;
+
+class TreeBuilder
+{
+private:
+    // nodes of one level standing in a row, by column; missing are empty
+    typedef QMap<int, shared_ptr<TreeNode> > Strip;
+
+    // a strip waiting for the strip below it
+    struct Pending
+    {
+        bool present;
+        int index; // the strip covers rows [index * 2^level, ...)
+        Strip strip;
+    };
+
+    int band;                    // index of the band being collected
+    QMap<int, quint64> blocks;   // its 8x8 blocks; bit 8 * row + column
+    QVector<Pending> pending;    // by level
+    QVector<shared_ptr<TreeNode> > emptyNodes;  // by level
+    shared_ptr<TreeNode> cells[2];              // dead and alive
+    shared_ptr<TreeNode> level1Nodes[16];       // all 2x2 nodes
+    QVector<shared_ptr<TreeNode> > level2Nodes; // 4x4 nodes built so far
+
+    shared_ptr<TreeNode> level2Node(int bits);
+    void flushBand();
+    void addStrip(int level, int index, const Strip &strip);
+    Strip join(int level, const Strip &upper, const Strip &lower);
+
+public:
+    TreeBuilder();
+
+    // makes "length" cells starting at (x, y) alive; x, y >= 0.
+    // Rows must come from top to bottom; runs within 8 rows may come in
+    // any order. Returns false if the run is above the band being
+    // collected
+    bool addRun(int x, int y, int length);
+
+    // returns the tree with the top left corner at (0, 0), of level
+    // minLevel or more (at least 3), and resets the builder
+    shared_ptr<TreeNode> finish(int minLevel = 3);
+
+    // the empty node of the level, the same one every time
+    shared_ptr<TreeNode> emptyNode(int level);
+
+    // an 8x8 node, bit 8 * row + column of "bits" being its cell; its 4x4
+    // quarters are shared with the other nodes made by this builder
+    shared_ptr<TreeNode> blockNode(quint64 bits);
+
+    // the cells living in "a" or "b", two trees of the same level; nodes
+    // of either tree are reused where the other one is empty
+    static shared_ptr<TreeNode> unite(shared_ptr<TreeNode> a,
+                                      shared_ptr<TreeNode> b);
+};
+
+#endif // TREEBUILDER_H
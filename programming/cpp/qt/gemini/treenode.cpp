@@ -8,30 +8,37 @@
 #include <limits>
 #include <memory>
 #include <unordered_map>
-#include <QPainter>
 
+#include "enginestats.h"
+#include "generationtask.h"
+#include "nodepager.h"
 #include "treenode.h"
 
 using namespace std;
 
-QHash<shared_ptr<TreeNode>, shared_ptr<TreeNode> > TreeNode::hashMap;
+QHash<shared_ptr<TreeNode>, shared_ptr<TreeNode> >
+    TreeNode::hashMap[TreeNode::maxStepLog2 + 1];
 
 TreeNode::TreeNode()
 {
-    nw = ne = sw = se = nullptr;
+    nwNode = neNode = swNode = seNode = nullptr;
+    paged = false;
     level = 0;
     alive = false;
     population = 0;
     hashValue = population;
+    EngineStats::nodeCreated(level);
 }
 
 TreeNode::TreeNode(bool living)
 {
-    nw = ne = sw = se = nullptr;
+    nwNode = neNode = swNode = seNode = nullptr;
+    paged = false;
     level = 0;
     alive = living;
     population = alive ? 1 : 0;
     hashValue = population;
+    EngineStats::nodeCreated(level);
 }
 
 /**
@@ -46,10 +53,11 @@ TreeNode::TreeNode(shared_ptr<TreeNode> nw,
                    shared_ptr<TreeNode> sw,
                    shared_ptr<TreeNode> se)
 {
-    this->nw = nw;
-    this->ne = ne;
-    this->sw = sw;
-    this->se = se;
+    nwNode = nw;
+    neNode = ne;
+    swNode = sw;
+    seNode = se;
+    paged = false;
     this->level = nw->level + 1;
     population = nw->population +
                 ne->population +
@@ -60,6 +68,32 @@ TreeNode::TreeNode(shared_ptr<TreeNode> nw,
                 11 * ne->hashValue +
                 101 * sw->hashValue +
                 1007 * se->hashValue;
+    EngineStats::nodeCreated(level);
+}
+
+TreeNode::TreeNode(int level, long population, uint hash)
+{
+    nwNode = neNode = swNode = seNode = nullptr;
+    paged = true;
+    this->level = level;
+    this->population = population;
+    alive = population > 0;
+    hashValue = hash;
+    EngineStats::nodeCreated(level);
+}
+
+TreeNode::~TreeNode()
+{
+    if (paged)
+    {
+        NodePager::release(this);
+    }
+    EngineStats::nodeDestroyed(level);
+}
+
+void TreeNode::pageIn() const
+{
+    NodePager::pageIn(this);
 }
 
 /**
@@ -82,34 +116,34 @@ shared_ptr<TreeNode> TreeNode::setBit(int x, int y)
    {
        if (y < 0)
        {
-           return make_shared<TreeNode>(nw->setBit(x + offset, y + offset),
-                                        ne,
-                                        sw,
-                                        se);
+           return make_shared<TreeNode>(nw()->setBit(x + offset, y + offset),
+                                        ne(),
+                                        sw(),
+                                        se());
        }
        else
        {
-           return make_shared<TreeNode>(nw,
-                                        ne,
-                                        sw->setBit(x + offset, y - offset),
-                                        se);
+           return make_shared<TreeNode>(nw(),
+                                        ne(),
+                                        sw()->setBit(x + offset, y - offset),
+                                        se());
        }
    }
    else
    {
        if (y < 0)
        {
-           return make_shared<TreeNode>(nw,
-                                        ne->setBit(x - offset, y + offset),
-                                        sw,
-                                        se);
+           return make_shared<TreeNode>(nw(),
+                                        ne()->setBit(x - offset, y + offset),
+                                        sw(),
+                                        se());
        }
        else
        {
-           return make_shared<TreeNode>(nw,
-                                        ne,
-                                        sw,
-                                        se->setBit(x - offset, y - offset));
+           return make_shared<TreeNode>(nw(),
+                                        ne(),
+                                        sw(),
+                                        se()->setBit(x - offset, y - offset));
        }
    }
 }
@@ -134,34 +168,34 @@ shared_ptr<TreeNode> TreeNode::unsetBit(int x, int y)
    {
        if (y < 0)
        {
-           return make_shared<TreeNode>(nw->unsetBit(x + offset, y + offset),
-                                        ne,
-                                        sw,
-                                        se);
+           return make_shared<TreeNode>(nw()->unsetBit(x + offset, y + offset),
+                                        ne(),
+                                        sw(),
+                                        se());
        }
        else
        {
-           return make_shared<TreeNode>(nw,
-                                        ne,
-                                        sw->unsetBit(x + offset, y - offset),
-                                        se);
+           return make_shared<TreeNode>(nw(),
+                                        ne(),
+                                        sw()->unsetBit(x + offset, y - offset),
+                                        se());
        }
    }
    else
    {
        if (y < 0)
        {
-           return make_shared<TreeNode>(nw,
-                                        ne->unsetBit(x - offset, y + offset),
-                                        sw,
-                                        se);
+           return make_shared<TreeNode>(nw(),
+                                        ne()->unsetBit(x - offset, y + offset),
+                                        sw(),
+                                        se());
        }
        else
        {
-           return make_shared<TreeNode>(nw,
-                                        ne,
-                                        sw,
-                                        se->unsetBit(x - offset, y - offset));
+           return make_shared<TreeNode>(nw(),
+                                        ne(),
+                                        sw(),
+                                        se()->unsetBit(x - offset, y - offset));
        }
    }
 }
@@ -184,22 +218,22 @@ int TreeNode::getBit(int x, int y)
    {
        if (y < 0)
        {
-           return nw->getBit(x + offset, y + offset);
+           return nw()->getBit(x + offset, y + offset);
        }
        else
        {
-           return sw->getBit(x + offset, y - offset);
+           return sw()->getBit(x + offset, y - offset);
        }
    }
    else
    {
        if (y < 0)
        {
-           return ne->getBit(x - offset, y + offset);
+           return ne()->getBit(x - offset, y + offset);
        }
        else
        {
-           return se->getBit(x - offset, y - offset);
+           return se()->getBit(x - offset, y - offset);
        }
    }
 }
@@ -225,14 +259,15 @@ shared_ptr<TreeNode> TreeNode::emptyTree(int level)
 */
 shared_ptr<TreeNode> TreeNode::expandUniverse()
 {
+   EngineStats::add(EngineStats::ExpandUniverse);
    shared_ptr<TreeNode> border = emptyTree(level - 1);
    return make_shared<TreeNode>(make_shared<TreeNode>(border, border,
-                                                      border, nw),
+                                                      border, nw()),
                                 make_shared<TreeNode>(border, border,
-                                                      ne,     border),
-                                make_shared<TreeNode>(border, sw,
+                                                      ne(),     border),
+                                make_shared<TreeNode>(border, sw(),
                                                       border, border),
-                                make_shared<TreeNode>(se,     border,
+                                make_shared<TreeNode>(se(),     border,
                                                       border, border));
 }
 
@@ -274,6 +309,7 @@ shared_ptr<TreeNode> TreeNode::oneGen(int bitmask)
 */
 shared_ptr<TreeNode> TreeNode::slowSimulation()
 {
+   EngineStats::add(EngineStats::BaseCases);
    int allbits = 0;
    for (int y = -2; y < 2; y++)
    {
@@ -292,7 +328,7 @@ shared_ptr<TreeNode> TreeNode::slowSimulation()
 */
 shared_ptr<TreeNode> TreeNode::centeredSubnode()
 {
-   return make_shared<TreeNode>(nw->se, ne->sw, sw->ne, se->nw);
+   return make_shared<TreeNode>(nw()->se(), ne()->sw(), sw()->ne(), se()->nw());
 }
 
 /**
@@ -304,7 +340,8 @@ shared_ptr<TreeNode> TreeNode::centeredSubnode()
 shared_ptr<TreeNode> TreeNode::centeredHorizontal(shared_ptr<TreeNode> w,
                                                  shared_ptr<TreeNode> e)
 {
-   return make_shared<TreeNode>(w->ne->se, e->nw->sw, w->se->ne, e->sw->nw);
+   return make_shared<TreeNode>(w->ne()->se(), e->nw()->sw(),
+                                w->se()->ne(), e->sw()->nw());
 }
 
 /**
@@ -313,8 +350,8 @@ shared_ptr<TreeNode> TreeNode::centeredHorizontal(shared_ptr<TreeNode> w,
 shared_ptr<TreeNode> TreeNode::centeredVertical(shared_ptr<TreeNode> n,
                                                shared_ptr<TreeNode> s)
 {
-   return make_shared<TreeNode>(n->sw->se, n->se->sw,
-                                s->nw->ne, s->ne->nw);
+   return make_shared<TreeNode>(n->sw()->se(), n->se()->sw(),
+                                s->nw()->ne(), s->ne()->nw());
 }
 
 /**
@@ -323,108 +360,20 @@ shared_ptr<TreeNode> TreeNode::centeredVertical(shared_ptr<TreeNode> n,
 */
 shared_ptr<TreeNode> TreeNode::centeredSubSubnode()
 {
-   return make_shared<TreeNode>(nw->se->se, ne->sw->sw,
-                                sw->ne->ne, se->nw->nw);
+   return make_shared<TreeNode>(nw()->se()->se(), ne()->sw()->sw(),
+                                sw()->ne()->ne(), se()->nw()->nw());
 }
 
 /**
-*   The recursive call that computes the next generation.  It works
-*   by constructing nine subnodes that are each a quarter the size
-*   of the current node in each dimension, and combining these in
-*   groups of four, building subnodes from these, and then
-*   recursively invoking the nextGeneration function and combining
-*   those final results into a single return value that is one
-*   half the size of the current node and advanced one generation in
-*   time.
+*   Advances this node by 2^stepLog2 generations; the work is done by
+*   GenerationTask
 */
-shared_ptr<TreeNode> TreeNode::nextGeneration()
+shared_ptr<TreeNode> TreeNode::nextGeneration(int stepLog2)
 {
-   shared_ptr<TreeNode> result = hashMap.value(shared_from_this(),
-                                               nullptr);
-   if (result != nullptr)
-   {
-       return result;
-   }
-   else
-   {
-       // skip empty regions quickly
-       if (population == 0)
-       {
-           return nw;
-       }
-       if (level == 2)
-       {
-           return hashMap[shared_from_this()] = slowSimulation();
-       }
-       shared_ptr<TreeNode> n00 = nw->centeredSubnode(),
-       n01 = centeredHorizontal(nw, ne),
-       n02 = ne->centeredSubnode(),
-       n10 = centeredVertical(nw, sw),
-       n11 = centeredSubSubnode(),
-       n12 = centeredVertical(ne, se),
-       n20 = sw->centeredSubnode(),
-       n21 = centeredHorizontal(sw, se),
-       n22 = se->centeredSubnode();
-       return hashMap[shared_from_this()] = make_shared<TreeNode>(
-                  make_shared<TreeNode>(n00, n01, n10, n11)->nextGeneration(),
-                  make_shared<TreeNode>(n01, n02, n11, n12)->nextGeneration(),
-                  make_shared<TreeNode>(n10, n11, n20, n21)->nextGeneration(),
-                  make_shared<TreeNode>(n11, n12, n21, n22)->nextGeneration());
-   }
-}
-
-void TreeNode::recDraw(QPainter* painter, int x0, int y0, int width)
-{
-   if (this->level == 1)
-   {
-       if (nw->population != 0)
-       {
-           painter->drawRect(x0 - width / 2,
-                             y0 - width / 2,
-                             width / 2,
-                             width / 2);
-       }
-       if (ne->population != 0)
-       {
-           painter->drawRect(x0,
-                             y0 - width / 2,
-                             width / 2,
-                             width / 2);
-       }
-       if (sw->population != 0)
-       {
-           painter->drawRect(x0 - width / 2,
-                             y0,
-                             width / 2,
-                             width / 2);
-       }
-       if (se->population != 0)
-       {
-           painter->drawRect(x0,
-                             y0,
-                             width / 2,
-                             width / 2);
-       }
-   }
-   else
-   {
-       if (nw->population != 0)
-       {
-           nw->recDraw(painter, x0 - width / 4, y0 - width / 4, width / 2);
-       }
-       if (ne->population != 0)
-       {
-           ne->recDraw(painter, x0 + width / 4, y0 - width / 4, width / 2);
-       }
-       if (sw->population != 0)
-       {
-           sw->recDraw(painter, x0 - width / 4, y0 + width / 4, width / 2);
-       }
-       if (se->population != 0)
-       {
-           se->recDraw(painter, x0 + width / 4, y0 + width / 4, width / 2);
-       }
-   }
+   GenerationTask task;
+   task.start(shared_from_this(), stepLog2);
+   task.run(-1);
+   return task.result();
 }
 
 /**
@@ -440,14 +389,14 @@ shared_ptr<TreeNode> TreeNode::rotateClockwise()
    }
    if (this->level == 1)
    {
-       return make_shared<TreeNode>(sw, nw, se, ne);
+       return make_shared<TreeNode>(sw(), nw(), se(), ne());
    }
    else
    {
-       return make_shared<TreeNode>(sw->rotateClockwise(),
-                                    nw->rotateClockwise(),
-                                    se->rotateClockwise(),
-                                    ne->rotateClockwise());
+       return make_shared<TreeNode>(sw()->rotateClockwise(),
+                                    nw()->rotateClockwise(),
+                                    se()->rotateClockwise(),
+                                    ne()->rotateClockwise());
    }
 }
 
@@ -464,14 +413,14 @@ shared_ptr<TreeNode> TreeNode::rotateAntiClockwise()
    }
    if (this->level == 1)
    {
-       return make_shared<TreeNode>(ne, se, nw, sw);
+       return make_shared<TreeNode>(ne(), se(), nw(), sw());
    }
    else
    {
-       return make_shared<TreeNode>(ne->rotateAntiClockwise(),
-                                    se->rotateAntiClockwise(),
-                                    nw->rotateAntiClockwise(),
-                                    sw->rotateAntiClockwise());
+       return make_shared<TreeNode>(ne()->rotateAntiClockwise(),
+                                    se()->rotateAntiClockwise(),
+                                    nw()->rotateAntiClockwise(),
+                                    sw()->rotateAntiClockwise());
    }
 }
 
@@ -481,7 +430,7 @@ shared_ptr<TreeNode> TreeNode::rotateAntiClockwise()
 */
 shared_ptr<TreeNode> TreeNode::getnw() const
 {
-   return nw;
+   return nw();
 }
 
 /**
@@ -490,7 +439,7 @@ shared_ptr<TreeNode> TreeNode::getnw() const
 */
 shared_ptr<TreeNode> TreeNode::getne() const
 {
-   return ne;
+   return ne();
 }
 
 /**
@@ -499,7 +448,7 @@ shared_ptr<TreeNode> TreeNode::getne() const
 */
 shared_ptr<TreeNode> TreeNode::getsw() const
 {
-   return sw;
+   return sw();
 }
 
 /**
@@ -508,7 +457,7 @@ shared_ptr<TreeNode> TreeNode::getsw() const
 */
 shared_ptr<TreeNode> TreeNode::getse() const
 {
-   return se;
+   return se();
 }
 
 /**
@@ -557,16 +506,16 @@ int TreeNode::leftBoundary() const
    }
    else
    {
-       if (nw->alive || sw->alive)
+       if (nw()->alive || sw()->alive)
        {
-           return min(nw->leftBoundary(), sw->leftBoundary());
+           return min(nw()->leftBoundary(), sw()->leftBoundary());
        }
        else
        {
            // either ne or se is alive, see the first condition of a function
            // 1 << (level - 1) = pow(2, level - 1)
            return (1 << (level - 1)) +
-                   min(ne->leftBoundary(), se->leftBoundary());
+                   min(ne()->leftBoundary(), se()->leftBoundary());
        }
    }
 }
@@ -590,16 +539,16 @@ int TreeNode::rightBoundary() const
    }
    else
    {
-       if (ne->alive || se->alive)
+       if (ne()->alive || se()->alive)
        {
            // 1 << (level - 1) = pow(2, level - 1)
            return (1 << (level - 1)) +
-                   max(ne->rightBoundary(), se->rightBoundary());
+                   max(ne()->rightBoundary(), se()->rightBoundary());
        }
        else
        {
            // either nw or sw is alive, see the first condition of a function
-           return max(nw->rightBoundary(), sw->rightBoundary());
+           return max(nw()->rightBoundary(), sw()->rightBoundary());
        }
    }
 }
@@ -623,16 +572,16 @@ int TreeNode::topBoundary() const
    }
    else
    {
-       if (nw->alive || ne->alive)
+       if (nw()->alive || ne()->alive)
        {
-           return min(nw->topBoundary(), ne->topBoundary());
+           return min(nw()->topBoundary(), ne()->topBoundary());
        }
        else
        {
            // either sw or se is alive, see the first condition of a function
            // 1 << (level - 1) = pow(2, level - 1)
            return (1 << (level - 1)) +
-                   min(sw->topBoundary(), se->topBoundary());
+                   min(sw()->topBoundary(), se()->topBoundary());
        }
    }
 }
@@ -656,16 +605,16 @@ int TreeNode::bottomBoundary() const
    }
    else
    {
-       if (sw->alive || se->alive)
+       if (sw()->alive || se()->alive)
        {
            // 1 << (level - 1) = pow(2, level - 1)
            return (1 << (level - 1)) +
-                   max(sw->bottomBoundary(), se->bottomBoundary());
+                   max(sw()->bottomBoundary(), se()->bottomBoundary());
        }
        else
        {
            // either nw or ne is alive, see the first condition of a function
-           return max(nw->bottomBoundary(), ne->bottomBoundary());
+           return max(nw()->bottomBoundary(), ne()->bottomBoundary());
        }
    }
 }
@@ -677,7 +626,20 @@ uint TreeNode::hash() const
 
 int TreeNode::hashSize()
 {
-    return hashMap.size();
+    int size = 0;
+    for (int i = 0; i <= maxStepLog2; i++)
+    {
+        size += hashMap[i].size();
+    }
+    return size;
+}
+
+void TreeNode::clearHash()
+{
+    for (int i = 0; i <= maxStepLog2; i++)
+    {
+        hashMap[i].clear();
+    }
 }
 
 uint qHash(shared_ptr<TreeNode> t)
@@ -687,6 +649,11 @@ uint qHash(shared_ptr<TreeNode> t)
 
 bool operator==(shared_ptr<TreeNode> arg1, shared_ptr<TreeNode> arg2)
 {
+   // shared subtrees are common, and comparing them cell by cell is slow
+   if (arg1.get() == arg2.get())
+   {
+       return true;
+   }
    if (arg1->getLevel() != arg2->getLevel())
    {
        return false;
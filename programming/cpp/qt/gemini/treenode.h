@@ -12,12 +12,16 @@
 #include <memory>
 #include <unordered_map>
 #include <QHash>
-#include <QPainter>
 
 using namespace std;
 
 class TreeNode : public enable_shared_from_this<TreeNode>
 {
+    friend class GenerationTask;
+    friend class NodePager;
+    friend class Rasterizer;
+    friend class TreeNodeBenchmark;
+
 public:
 
     TreeNode();
@@ -40,6 +44,10 @@ public:
              shared_ptr<TreeNode> sw,
              shared_ptr<TreeNode> se);
 
+    // counts the node out of EngineStats; a paged node is also forgotten
+    // by its pager
+    ~TreeNode();
+
     /**
      * @brief Sets a certain cell of a tree to 1 (-level^2 <= x, y < level^2)
      * @param -level ^ 2 <= x < level ^ 2
@@ -84,20 +92,15 @@ public:
     *   groups of four, building subnodes from these, and then
     *   recursively invoking the nextGeneration function and combining
     *   those final results into a single return value that is one
-    *   half the size of the current node and advanced one generation in
-    *   time.
+    *   half the size of the current node and advanced 2^stepLog2
+    *   generations in time.
+    *   A node of level L can not be advanced further than 2^(L-2)
+    *   generations, so stepLog2 is clamped to L-2.
+    *   The recursion itself is done by GenerationTask, which can also
+    *   compute it in portions.
+    *   @param stepLog2 - 0 <= stepLog2 <= maxStepLog2
     */
-    shared_ptr<TreeNode> nextGeneration();
-
-    /**
-     * @brief Draws this node so that (x0, y0) is in the cenre of it, and the
-     * width of the painted node is equal to width
-     * @param painter - QPainter instance used for painting this node
-     * @param x0 - x coordinate of the centre of the node
-     * @param y0 - y coordinate of the centre of the node
-     * @param width - width of the painted node
-     */
-    void recDraw(QPainter* painter, int x0, int y0, int width);
+    shared_ptr<TreeNode> nextGeneration(int stepLog2);
 
     /**
      * @brief Rotates a TreeNode clockwise
@@ -196,15 +199,70 @@ public:
 
     static int hashSize();
 
+    // forgets all the results of nextGeneration, freeing the memory
+    static void clearHash();
+
+    // the biggest step (as a power of two) nextGeneration can make
+    static const int maxStepLog2 = 24;
+
 private:
 
     bool alive; //if this is a leaf node, is it alive?
                 //if nonleaf, does it have any living cells?
+    bool paged; // made by NodePager from a snapshot
     long population; //number of living cells
     uint hashValue;
     int level; //distance to the root
-    shared_ptr<TreeNode> nw, ne, sw, se; //children
-    static QHash<shared_ptr<TreeNode>, shared_ptr<TreeNode> > hashMap;
+    // children; those of a paged node are read from its file when they are
+    // first needed and may be dropped again by the pager (see nodepager.h),
+    // so they are used through nw(), ne(), sw() and se()
+    mutable shared_ptr<TreeNode> nwNode, neNode, swNode, seNode;
+    // results of nextGeneration; hashMap[i] stores the nodes advanced by
+    // 2^i generations, so changing the step size does not lose them
+    static QHash<shared_ptr<TreeNode>, shared_ptr<TreeNode> >
+        hashMap[maxStepLog2 + 1];
+
+    // a paged node whose children are not read yet
+    TreeNode(int level, long population, uint hash);
+
+    // reads the children of a paged node
+    void pageIn() const;
+
+    const shared_ptr<TreeNode> &nw() const
+    {
+        if (nwNode == nullptr && paged)
+        {
+            pageIn();
+        }
+        return nwNode;
+    }
+
+    const shared_ptr<TreeNode> &ne() const
+    {
+        if (neNode == nullptr && paged)
+        {
+            pageIn();
+        }
+        return neNode;
+    }
+
+    const shared_ptr<TreeNode> &sw() const
+    {
+        if (swNode == nullptr && paged)
+        {
+            pageIn();
+        }
+        return swNode;
+    }
+
+    const shared_ptr<TreeNode> &se() const
+    {
+        if (seNode == nullptr && paged)
+        {
+            pageIn();
+        }
+        return seNode;
+    }
 
     /**
     *   Given an integer with a bitmask indicating which bits are
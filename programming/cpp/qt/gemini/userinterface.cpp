@@ -9,6 +9,7 @@
 #include <QString>
 #include <QtWidgets>
 
+#include "tracer.h"
 #include "userinterface.h"
 
 UserInterface::UserInterface()
@@ -39,8 +40,14 @@ UserInterface::UserInterface()
             this,
             SLOT(changeMode(QModelIndex)));
 
+    minimap = new Minimap(gridPainter);
+
+    modeAndMinimap = new QVBoxLayout;
+    modeAndMinimap->addWidget(mode);
+    modeAndMinimap->addWidget(minimap, 0, Qt::AlignHCenter);
+
     painterAndMode = new QHBoxLayout;
-    painterAndMode->addWidget(mode);
+    painterAndMode->addLayout(modeAndMinimap);
     painterAndMode->addWidget(gridPainter, 1);
     // 1 means that gridPainter gets as big as possible when the window is
     // stretched
@@ -57,6 +64,11 @@ UserInterface::UserInterface()
     all->setLayout(layout);
 
     propertiesWindow = new PropertiesWindow();
+    fileProgressDialog = nullptr;
+    lastSteps = 0;
+    lastStepNanoseconds = 0;
+    lastRepaintedPixels = 0;
+    lastWidgetPixels = 0;
 
     createActions();
     createMenus();
@@ -67,8 +79,16 @@ UserInterface::UserInterface()
 
     timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), gridPainter, SLOT(animate()));
+    connect(timer, SIGNAL(timeout()), minimap, SLOT(update()));
     connect(timer, SIGNAL(timeout()), this, SLOT(updatePropertiesWindow()));
+    connect(timer, SIGNAL(timeout()), this, SLOT(updateFileProgress()));
     timer->start(100);
+
+    connect(gridPainter,
+            SIGNAL(fileFinished(bool, bool, QString)),
+            this,
+            SLOT(fileFinished(bool, bool, QString)));
+    connect(gridPainter, SIGNAL(limitReached()), this, SLOT(limitReached()));
 }
 
 void UserInterface::createActions()
@@ -91,6 +111,46 @@ void UserInterface::createActions()
             this,
             SLOT(saveAsPlainTextFile()));
 
+    openMacrocellFileAct = new QAction(tr("Open &macrocell file"), this);
+    connect(openMacrocellFileAct,
+            SIGNAL(triggered()),
+            this,
+            SLOT(openMacrocellFile()));
+
+    saveAsMacrocellFileAct = new QAction(tr("Save as m&acrocell file"), this);
+    connect(saveAsMacrocellFileAct,
+            SIGNAL(triggered()),
+            this,
+            SLOT(saveAsMacrocellFile()));
+
+    openSnapshotFileAct = new QAction(tr("Open s&napshot"), this);
+    connect(openSnapshotFileAct,
+            SIGNAL(triggered()),
+            this,
+            SLOT(openSnapshotFile()));
+
+    openPagedSnapshotFileAct = new QAction(tr("Open snapshot &paged"), this);
+    connect(openPagedSnapshotFileAct,
+            SIGNAL(triggered()),
+            this,
+            SLOT(openPagedSnapshotFile()));
+
+    saveAsSnapshotFileAct = new QAction(tr("Save s&napshot"), this);
+    connect(saveAsSnapshotFileAct,
+            SIGNAL(triggered()),
+            this,
+            SLOT(saveAsSnapshotFile()));
+
+    recordTraceAct = new QAction(tr("&Record trace"), this);
+    recordTraceAct->setCheckable(true);
+    connect(recordTraceAct,
+            SIGNAL(toggled(bool)),
+            this,
+            SLOT(recordTrace(bool)));
+
+    exportTraceAct = new QAction(tr("&Export trace"), this);
+    connect(exportTraceAct, SIGNAL(triggered()), this, SLOT(exportTrace()));
+
     initRandomAct = new QAction(tr("&Fill with random data"), this);
     connect(initRandomAct, SIGNAL(triggered()), this, SLOT(initRandom()));
 
@@ -103,6 +163,19 @@ void UserInterface::createActions()
     setGridColorAct = new QAction(tr("Set &grid colour"), this);
     connect(setGridColorAct, SIGNAL(triggered()), this, SLOT(setGridColor()));
 
+    showHeatmapAct = new QAction(tr("Show density &heatmap"), this);
+    showHeatmapAct->setCheckable(true);
+    connect(showHeatmapAct,
+            SIGNAL(toggled(bool)),
+            gridPainter,
+            SLOT(setHeatmap(bool)));
+
+    setHeatmapColorsAct = new QAction(tr("Set heatmap c&olours"), this);
+    connect(setHeatmapColorsAct,
+            SIGNAL(triggered()),
+            this,
+            SLOT(setHeatmapColors()));
+
     chooseWhiteThemeAct = new QAction(tr("Choose &white theme"), this);
     connect(chooseWhiteThemeAct,
             SIGNAL(triggered()),
@@ -118,9 +191,26 @@ void UserInterface::createActions()
     fitPatternAct = new QAction(tr("&Fit pattern"), this);
     connect(fitPatternAct, SIGNAL(triggered()), this, SLOT(fitPattern()));
 
+    showMinimapAct = new QAction(tr("Show &minimap"), this);
+    showMinimapAct->setCheckable(true);
+    showMinimapAct->setChecked(true);
+    connect(showMinimapAct,
+            SIGNAL(toggled(bool)),
+            minimap,
+            SLOT(setVisible(bool)));
+
     setUpdateRateAct = new QAction(tr("Set &refresh rate"), this);
     connect(setUpdateRateAct, SIGNAL(triggered()), this, SLOT(setUpdateRate()));
 
+    setTargetRateAct = new QAction(tr("Set &target speed"), this);
+    connect(setTargetRateAct, SIGNAL(triggered()), this, SLOT(setTargetRate()));
+
+    setFrameBudgetAct = new QAction(tr("Set frame &budget"), this);
+    connect(setFrameBudgetAct,
+            SIGNAL(triggered()),
+            this,
+            SLOT(setFrameBudget()));
+
     rotateClockwiseAct = new QAction(tr("&Rotate clock wise"), this);
     connect(rotateClockwiseAct,
             SIGNAL(triggered()),
@@ -143,18 +233,31 @@ void UserInterface::createMenus()
     fileMenu->addAction(openPlainTextFileAct);
     fileMenu->addAction(saveAsRleFileAct);
     fileMenu->addAction(saveAsPlainTextFileAct);
+    fileMenu->addAction(openMacrocellFileAct);
+    fileMenu->addAction(saveAsMacrocellFileAct);
+    fileMenu->addAction(openSnapshotFileAct);
+    fileMenu->addAction(openPagedSnapshotFileAct);
+    fileMenu->addAction(saveAsSnapshotFileAct);
+    fileMenu->addSeparator();
+    fileMenu->addAction(recordTraceAct);
+    fileMenu->addAction(exportTraceAct);
 
     viewMenu = new QMenu(tr("&View"));
     viewMenu->addAction(setCellColorAct);
     viewMenu->addAction(setSpaceColorAct);
     viewMenu->addAction(setGridColorAct);
+    viewMenu->addAction(showHeatmapAct);
+    viewMenu->addAction(setHeatmapColorsAct);
     viewMenu->addSeparator();
     viewMenu->addAction(chooseWhiteThemeAct);
     viewMenu->addAction(chooseBlackThemeAct);
     viewMenu->addSeparator();
     viewMenu->addAction(fitPatternAct);
+    viewMenu->addAction(showMinimapAct);
     viewMenu->addSeparator();
     viewMenu->addAction(setUpdateRateAct);
+    viewMenu->addAction(setTargetRateAct);
+    viewMenu->addAction(setFrameBudgetAct);
 
     editMenu = new QMenu(tr("&Edit"));
     editMenu->addAction(initRandomAct);
@@ -267,6 +370,22 @@ void UserInterface::setGridColor()
     gridPainter->update();
 }
 
+void UserInterface::setHeatmapColors()
+{
+    if (!gridPainter->isStopped())
+    {
+        stopButtonPressed();
+    }
+    QColor sparse = QColorDialog::getColor(QColor(70, 0, 140),
+                                           this,
+                                           "Select color of sparse places");
+    QColor dense = QColorDialog::getColor(QColor(255, 230, 0),
+                                          this,
+                                          "Select color of dense places");
+    gridPainter->setHeatmapColors(sparse, dense);
+    gridPainter->update();
+}
+
 void UserInterface::chooseWhiteTheme()
 {
     gridPainter->setCellColor(QColor(0, 0, 0));
@@ -300,27 +419,161 @@ void UserInterface::setUpdateRate()
                                           1));
 }
 
+void UserInterface::setTargetRate()
+{
+    bool ok;
+    double rate = QInputDialog::getDouble(this,
+                               tr("Enter target speed"),
+                               tr("Generations per second (0 - as fast as "
+                                  "possible):"),
+                               gridPainter->getTargetRate(),
+                               0,
+                               1e12,
+                               1,
+                               &ok);
+    if (ok)
+    {
+        gridPainter->setTargetRate(rate);
+    }
+}
+
+void UserInterface::setFrameBudget()
+{
+    bool ok;
+    int budget = QInputDialog::getInt(this,
+                               tr("Enter frame budget"),
+                               tr("Milliseconds of computing per frame:"),
+                               gridPainter->getFrameBudget(),
+                               1,
+                               10000,
+                               1,
+                               &ok);
+    if (ok)
+    {
+        gridPainter->setFrameBudget(budget);
+    }
+}
+
 void UserInterface::openRleFile()
 {
-    if (!gridPainter->isStopped())
+    QString fileName =
+            QFileDialog::getOpenFileName(this,
+                                         tr("Open RLE file"),
+                                         QString(),
+                                         tr("RLE Files (*.rle);;"
+                                            "All Files (*)"));
+    if (fileName.isEmpty())
     {
-        stopButtonPressed();
+        return;
     }
+    startFile(true, RLE, fileName);
+}
 
+void UserInterface::openPlainTextFile()
+{
     QString fileName = QFileDialog::getOpenFileName(this,
-                                                    tr("Open RLE file"));
+                                                  tr("Open plain text file"));
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    startFile(true, PLAIN_TEXT, fileName);
+}
+
+void UserInterface::saveAsRleFile()
+{
+    QString fileName =
+            QFileDialog::getSaveFileName(this,
+                                         tr("Save as RLE file"),
+                                         QString(),
+                                         tr("RLE Files (*.rle);;"
+                                            "All Files (*)"));
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    startFile(false, RLE, fileName);
+}
 
-    QMessageBox msgBox;
-    msgBox.setWindowTitle(tr("Error when opening the file"));
-    msgBox.setIcon(QMessageBox::Warning);
-    msgBox.setText(tr("An error might have occured when opening the file"));
-    msgBox.setStandardButtons(QMessageBox::Ok);
-    msgBox.setDefaultButton(QMessageBox::Ok);
+void UserInterface::saveAsPlainTextFile()
+{
+    QString fileName =
+            QFileDialog::getSaveFileName(this, tr("Save as plain text file"));
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    startFile(false, PLAIN_TEXT, fileName);
+}
 
-    if (!gridPainter->parseRLE(fileName))
+void UserInterface::openMacrocellFile()
+{
+    QString fileName =
+            QFileDialog::getOpenFileName(this,
+                                         tr("Open macrocell file"),
+                                         QString(),
+                                         tr("Macrocell Files (*.mc);;"
+                                            "All Files (*)"));
+    if (fileName.isEmpty())
     {
-        setWindowTitle(tr("Conway's game of Life"));
-        msgBox.exec();
+        return;
+    }
+    startFile(true, MACROCELL, fileName);
+}
+
+void UserInterface::saveAsMacrocellFile()
+{
+    QString fileName =
+            QFileDialog::getSaveFileName(this,
+                                         tr("Save as macrocell file"),
+                                         QString(),
+                                         tr("Macrocell Files (*.mc);;"
+                                            "All Files (*)"));
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    startFile(false, MACROCELL, fileName);
+}
+
+void UserInterface::openSnapshotFile()
+{
+    QString fileName =
+            QFileDialog::getOpenFileName(this,
+                                         tr("Open snapshot"),
+                                         QString(),
+                                         tr("Snapshots (*.gsnap);;"
+                                            "All Files (*)"));
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    startFile(true, SNAPSHOT, fileName);
+}
+
+void UserInterface::openPagedSnapshotFile()
+{
+    if (!gridPainter->isStopped())
+    {
+        stopButtonPressed();
+    }
+
+    QString fileName =
+            QFileDialog::getOpenFileName(this,
+                                         tr("Open snapshot"),
+                                         QString(),
+                                         tr("Snapshots (*.gsnap);;"
+                                            "All Files (*)"));
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    if (!gridPainter->openPaged(fileName))
+    {
+        QMessageBox::warning(this,
+                             tr("Error when opening the file"),
+                             tr("Could not read the snapshot"));
     }
     else
     {
@@ -333,50 +586,146 @@ void UserInterface::openRleFile()
     gridPainter->update();
 }
 
-void UserInterface::openPlainTextFile()
+void UserInterface::saveAsSnapshotFile()
 {
-    if (!gridPainter->isStopped())
+    QString fileName =
+            QFileDialog::getSaveFileName(this,
+                                         tr("Save snapshot"),
+                                         QString(),
+                                         tr("Snapshots (*.gsnap);;"
+                                            "All Files (*)"));
+    if (fileName.isEmpty())
     {
-        stopButtonPressed();
+        return;
     }
+    startFile(false, SNAPSHOT, fileName);
+}
 
-    QString fileName = QFileDialog::getOpenFileName(this,
-                                                  tr("Open plain text file"));
-    QMessageBox msgBox;
-    msgBox.setWindowTitle(tr("Error when opening the file"));
-    msgBox.setIcon(QMessageBox::Warning);
-    msgBox.setText(tr("An error might have occured when opening the file"));
-    msgBox.setStandardButtons(QMessageBox::Ok);
-    msgBox.setDefaultButton(QMessageBox::Ok);
+/**
+*   The progress dialog is not modal: the field can be looked at and run
+*   while the file is read or written. It shows itself if the file takes
+*   more than half a second, and cancelling it cancels the file.
+*/
+void UserInterface::startFile(bool loading,
+                              FILE_FORMAT format,
+                              const QString &fileName)
+{
+    bool started = loading ? gridPainter->startLoading(format, fileName)
+                           : gridPainter->startSaving(format, fileName);
+    if (!started)
+    {
+        QMessageBox::warning(this,
+                             tr("File in use"),
+                             tr("Another file is being read or written"));
+        return;
+    }
+    // fileFinished comes from the event loop, so not before the dialog
+    QString text = loading ? tr("Reading ") : tr("Writing ");
+    fileProgressDialog = new QProgressDialog(text + fileName,
+                                             tr("Cancel"),
+                                             0,
+                                             1000,
+                                             this);
+    fileProgressDialog->setMinimumDuration(500);
+    fileProgressDialog->setValue(0);
+    connect(fileProgressDialog,
+            SIGNAL(canceled()),
+            gridPainter,
+            SLOT(cancelFile()));
+}
 
-    if (!gridPainter->parsePlainText(fileName))
+void UserInterface::updateFileProgress()
+{
+    if (fileProgressDialog == nullptr || fileProgressDialog->wasCanceled())
     {
-        setWindowTitle(tr("Conway's game of Life"));
-        msgBox.exec();
+        return;
+    }
+    double fraction = gridPainter->getFileProgress();
+    if (fraction < 0)
+    {
+        // the size is not known: the bar just shows that it is busy
+        fileProgressDialog->setMaximum(0);
+        fileProgressDialog->setValue(0);
     }
     else
     {
+        // the dialog would close itself at the maximum
+        fileProgressDialog->setMaximum(1000);
+        fileProgressDialog->setValue(qMin((int)(fraction * 1000), 999));
+    }
+}
+
+void UserInterface::fileFinished(bool loading,
+                                 bool success,
+                                 const QString &fileName)
+{
+    bool cancelled = fileProgressDialog->wasCanceled();
+    fileProgressDialog->deleteLater();
+    fileProgressDialog = nullptr;
+
+    if (!success && !cancelled)
+    {
+        if (loading)
+        {
+            QMessageBox::warning(this,
+                                 tr("Error when opening the file"),
+                                 tr("Could not read ") + fileName);
+        }
+        else
+        {
+            QMessageBox::warning(this,
+                                 tr("Error when saving the file"),
+                                 tr("Could not write ") + fileName);
+        }
+    }
+    if (loading && success)
+    {
+        // the field loaded is not running
+        stopButton->setText(tr("Start"));
         // "filename" - Conway's game of Life
         setWindowTitle(fileName.right(fileName.length() -
                                       fileName.lastIndexOf('/')- 1) +
                                       tr(" - Conway's game of Life"));
     }
-    gridPainter->update();
 }
 
-void UserInterface::saveAsRleFile()
+void UserInterface::limitReached()
 {
-    QString fileName =
-            QFileDialog::getOpenFileName(this,
-                                         tr("Select file"),
-                                        tr("All Files (*);;RLE Files (*.rle)"));
-    gridPainter->saveAsRLE(fileName);
+    stopButton->setText(tr("Start"));
+    QMessageBox::warning(this,
+                         tr("The field is too big"),
+                         tr("The field can not grow beyond 2^") +
+                         QString::number(Grid::maxLevel) +
+                         tr(" cells, so it is stopped at generation ") +
+                         QString::number(gridPainter->getGenerationCount()));
 }
 
-void UserInterface::saveAsPlainTextFile()
+void UserInterface::recordTrace(bool record)
+{
+    if (record)
+    {
+        Tracer::clear();
+    }
+    Tracer::setEnabled(record);
+}
+
+void UserInterface::exportTrace()
 {
-    QString fileName = QFileDialog::getOpenFileName(this, tr("Select file"));
-    gridPainter->saveAsPlainText(fileName);
+    QString fileName =
+            QFileDialog::getSaveFileName(this,
+                                         tr("Export trace"),
+                                         "gemini-trace.json",
+                                         tr("Chrome trace (*.json)"));
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    if (!Tracer::exportChromeTrace(fileName))
+    {
+        QMessageBox::warning(this,
+                             tr("Export trace"),
+                             tr("Could not write ") + fileName);
+    }
 }
 
 void UserInterface::initRandom()
@@ -447,6 +796,44 @@ void UserInterface::updatePropertiesWindow()
     propertiesWindow->setGeneration(gridPainter->getGenerationCount());
     propertiesWindow->setPopulation(gridPainter->getPopulation());
     propertiesWindow->setHashSize(gridPainter->getHashSize());
+    propertiesWindow->setSpeed(gridPainter->getAchievedRate(),
+                               gridPainter->getStepLog2());
+    propertiesWindow->setStepProgress(gridPainter->getStepProgress());
+
+    long long steps = gridPainter->getCounter(EngineStats::Steps);
+    long long stepNanoseconds =
+        gridPainter->getCounter(EngineStats::StepNanoseconds);
+    if (steps > lastSteps)
+    {
+        propertiesWindow->setStepTime((stepNanoseconds -
+                                       lastStepNanoseconds) / 1e6 /
+                                      (steps - lastSteps));
+        lastSteps = steps;
+        lastStepNanoseconds = stepNanoseconds;
+    }
+    long long repaintedPixels =
+        gridPainter->getCounter(EngineStats::RepaintedPixels);
+    long long widgetPixels =
+        gridPainter->getCounter(EngineStats::WidgetPixels);
+    if (widgetPixels > lastWidgetPixels)
+    {
+        propertiesWindow->setRepaintedShare(
+            (double)(repaintedPixels - lastRepaintedPixels) /
+            (widgetPixels - lastWidgetPixels));
+        lastRepaintedPixels = repaintedPixels;
+        lastWidgetPixels = widgetPixels;
+    }
+    propertiesWindow->setMemoStats(
+        gridPainter->getCounter(EngineStats::MemoHits),
+        gridPainter->getCounter(EngineStats::MemoMisses));
+    propertiesWindow->setNodeStats(gridPainter->getNodesAlive(),
+                                   gridPainter->getNodesCreated());
+    propertiesWindow->setMemoryInUse(gridPainter->getBytesInUse());
+    propertiesWindow->setBaseCases(
+        gridPainter->getCounter(EngineStats::BaseCases),
+        gridPainter->getCounter(EngineStats::ExpandUniverse));
+    propertiesWindow->setNodesPerLevel(gridPainter->getNodesAlivePerLevel(),
+                                       gridPainter->getNodesCreatedPerLevel());
 }
 
 void UserInterface::keyPressEvent(QKeyEvent * event)
@@ -17,6 +17,7 @@
 #include <QMainWindow>
 #include <QMenu>
 #include <QMenuBar>
+#include <QProgressDialog>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
@@ -25,6 +26,7 @@
 #include <QWidget>
 
 #include "gridpainter.h"
+#include "minimap.h"
 #include "propertieswindow.h"
 
 class UserInterface : public QMainWindow
@@ -38,22 +40,37 @@ private slots:
     void setCellColor();
     void setSpaceColor();
     void setGridColor();
+    void setHeatmapColors();
     void chooseWhiteTheme();
     void chooseBlackTheme();
     void fitPattern();
     void setUpdateRate();
+    void setTargetRate();
+    void setFrameBudget();
     void openRleFile();
     void openPlainTextFile();
     void saveAsRleFile();
     void saveAsPlainTextFile();
+    void openMacrocellFile();
+    void saveAsMacrocellFile();
+    void openSnapshotFile();
+    void openPagedSnapshotFile();
+    void saveAsSnapshotFile();
+    void recordTrace(bool record);
+    void exportTrace();
     void initRandom();
     void changeMode(const QModelIndex & index);
     void stopButtonPressed();
     void updatePropertiesWindow();
+    void updateFileProgress();
+    void fileFinished(bool loading, bool success, const QString &fileName);
+    // the field has grown as big as it can
+    void limitReached();
 
 private:
     void createActions();
     void createMenus();
+    void startFile(bool loading, FILE_FORMAT format, const QString &fileName);
     QAbstractItemModel *modelFromFile(const QString& fileName);
 
     QWidget *all; // All widgets belong to this
@@ -68,15 +85,27 @@ private:
     QAction *setCellColorAct;
     QAction *setSpaceColorAct;
     QAction *setGridColorAct;
+    QAction *showHeatmapAct;
+    QAction *setHeatmapColorsAct;
     QAction *chooseWhiteThemeAct;
     QAction *chooseBlackThemeAct;
     QAction *fitPatternAct;
+    QAction *showMinimapAct;
     QAction *setUpdateRateAct;
+    QAction *setTargetRateAct;
+    QAction *setFrameBudgetAct;
     QAction *initRandomAct;
     QAction *openRleFileAct;
     QAction *openPlainTextFileAct;
     QAction *saveAsRleFileAct;
     QAction *saveAsPlainTextFileAct;
+    QAction *openMacrocellFileAct;
+    QAction *saveAsMacrocellFileAct;
+    QAction *openSnapshotFileAct;
+    QAction *openPagedSnapshotFileAct;
+    QAction *saveAsSnapshotFileAct;
+    QAction *recordTraceAct;
+    QAction *exportTraceAct;
     QAction *rotateClockwiseAct;
     QAction *rotateAntiClockwiseAct;
     QTimer *timer; // Calls gridPainter::animate() and
@@ -84,9 +113,21 @@ private:
     QVBoxLayout *layout; // contains mainLayout and painterAndMode
     QHBoxLayout *mainLayout; // contains buttons at the bottom
     QTreeView *mode; // specifies a drawing/erasing pattern and mode
-    QHBoxLayout *painterAndMode; // contains gridPainter and mode
+    Minimap *minimap; // the whole field, under mode
+    QVBoxLayout *modeAndMinimap; // contains mode and minimap
+    QHBoxLayout *painterAndMode; // contains gridPainter, mode and minimap
     PropertiesWindow *propertiesWindow; // Shows various information about
                                         // the automata
+    QProgressDialog *fileProgressDialog; // while a file is read or written
+
+    // EngineStats::Steps and StepNanoseconds at the previous update of
+    // propertiesWindow, to show the time of the latest steps
+    long long lastSteps;
+    long long lastStepNanoseconds;
+    // EngineStats::RepaintedPixels and WidgetPixels, likewise, to show how
+    // much of the field the latest frames painted again
+    long long lastRepaintedPixels;
+    long long lastWidgetPixels;
 
     int drawingIndex; // index of "drawing" in treeView
     int erasingIndex; // index of "erasing" in treeView
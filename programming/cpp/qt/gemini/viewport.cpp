@@ -0,0 +1,167 @@
+/* KPCC
+ * Viewport is the part of the field shown in a widget
+ * File: viewport.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "viewport.h"
+
+using namespace std;
+
+Viewport::Viewport()
+{
+    centerX = 0;
+    centerY = 0;
+    fractionX = 0;
+    fractionY = 0;
+    scale = 10;
+    width = 0;
+    height = 0;
+}
+
+void Viewport::setSize(const QSize &size)
+{
+    width = size.width();
+    height = size.height();
+}
+
+QSize Viewport::getSize() const
+{
+    return QSize(width, height);
+}
+
+void Viewport::setScale(double scale)
+{
+    this->scale = min(max(scale, 1.0 / maxCellsPerPixel),
+                      (double)maxCellWidth);
+    if (this->scale >= 1)
+    {
+        this->scale = snap(this->scale);
+    }
+}
+
+double Viewport::getScale() const
+{
+    return scale;
+}
+
+qint64 Viewport::getCenterX() const
+{
+    return centerX;
+}
+
+qint64 Viewport::getCenterY() const
+{
+    return centerY;
+}
+
+double Viewport::getOriginX() const
+{
+    return snap(width / 2 - fractionX * scale);
+}
+
+double Viewport::getOriginY() const
+{
+    return snap(height / 2 - fractionY * scale);
+}
+
+double Viewport::pixelX(qint64 x) const
+{
+    return (double)(x - centerX) * scale + getOriginX();
+}
+
+double Viewport::pixelY(qint64 y) const
+{
+    return (double)(y - centerY) * scale + getOriginY();
+}
+
+qint64 Viewport::cellX(double x) const
+{
+    return centerX + (qint64)floor(fractionX + (x - width / 2) / scale);
+}
+
+qint64 Viewport::cellY(double y) const
+{
+    return centerY + (qint64)floor(fractionY + (y - height / 2) / scale);
+}
+
+QRectF Viewport::visibleCells() const
+{
+    return QRectF(centerX + fractionX - width / 2 / scale,
+                  centerY + fractionY - height / 2 / scale,
+                  width / scale,
+                  height / scale);
+}
+
+void Viewport::moveBy(double dx, double dy)
+{
+    fractionX -= dx / scale;
+    fractionY -= dy / scale;
+    normalize();
+}
+
+void Viewport::zoom(double factor, const QPointF &pixel)
+{
+    double oldScale = scale;
+    setScale(scale * factor);
+    double dx = pixel.x() - width / 2;
+    double dy = pixel.y() - height / 2;
+    fractionX += dx / oldScale - dx / scale;
+    fractionY += dy / oldScale - dy / scale;
+    normalize();
+}
+
+void Viewport::centerOn(double x, double y)
+{
+    centerX = 0;
+    centerY = 0;
+    fractionX = x;
+    fractionY = y;
+    normalize();
+}
+
+void Viewport::fit(qint64 left, qint64 top, qint64 width, qint64 height)
+{
+    width = max(width, 1LL);
+    height = max(height, 1LL);
+    setScale(min((double)this->width / width, (double)this->height / height));
+    centerOn(left + width / 2.0, top + height / 2.0);
+}
+
+/**
+*   The fractions are at most a widget away from [0, 1) after a move, a
+*   few thousand pixels over the smallest scale, so they stay exact
+*   enough as doubles.
+*/
+void Viewport::normalize()
+{
+    double wholeX = floor(fractionX);
+    double wholeY = floor(fractionY);
+    fractionX -= wholeX;
+    fractionY -= wholeY;
+    centerX = moveCenter(centerX, wholeX);
+    centerY = moveCenter(centerY, wholeY);
+}
+
+qint64 Viewport::moveCenter(qint64 center, double cells)
+{
+    double limit = maxCoordinate;
+    // both are below 2^62, so the sum fits
+    center += (qint64)min(max(cells, -2 * limit), 2 * limit);
+    if (center > maxCoordinate)
+    {
+        return maxCoordinate;
+    }
+    if (center < -maxCoordinate)
+    {
+        return -maxCoordinate;
+    }
+    return center;
+}
+
+double Viewport::snap(double pixels)
+{
+    return ldexp(floor(ldexp(pixels, subpixelBits)), -subpixelBits);
+}
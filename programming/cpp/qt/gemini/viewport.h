@@ -0,0 +1,97 @@
+/* KPCC
+ * Viewport is the part of the field shown in a widget: the cell in the
+ * centre of the widget, as a 64-bit coordinate and a fraction of a cell,
+ * and the width of a cell in pixels, which may be less than one. Cells
+ * are counted as by Grid::setAlive, from the centre of the field, so a
+ * field that grows around its centre does not move. Only the distance of
+ * a cell from the centre is turned into a double, so the cells on the
+ * screen are placed exactly however far from the field they are
+ * File: viewport.h
+ */
+
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+#include <QPointF>
+#include <QRectF>
+#include <QSize>
+
+class Viewport
+{
+private:
+    qint64 centerX;   // the cell in the centre of the widget
+    qint64 centerY;
+    double fractionX; // where in that cell the centre is, [0, 1)
+    double fractionY;
+    double scale;     // pixels per cell
+    int width;        // of the widget
+    int height;
+
+    // moves the whole cells out of the fractions into the centre
+    void normalize();
+
+    // "center" moved by a whole number of "cells", kept within
+    // maxCoordinate
+    static qint64 moveCenter(qint64 center, double cells);
+
+    // the value rounded down to a whole 2^-subpixelBits of a pixel
+    static double snap(double pixels);
+
+public:
+    // cells 10 pixels wide, cell (0, 0) in the centre
+    Viewport();
+
+    void setSize(const QSize &size);
+    QSize getSize() const;
+
+    // the width of a cell in pixels, kept between 1 / maxCellsPerPixel and
+    // maxCellWidth; the centre stays where it is. A cell a pixel or wider
+    // is kept to whole 2^-subpixelBits of a pixel, as is the origin: the
+    // edges of the cells on the screen then add up exactly, the same
+    // whether counted from the centre or from the corner of a node
+    void setScale(double scale);
+    double getScale() const;
+
+    qint64 getCenterX() const;
+    qint64 getCenterY() const;
+
+    // the pixel of the top left corner of the centre cell; cell x starts
+    // at (x - getCenterX()) * getScale() + getOriginX()
+    double getOriginX() const;
+    double getOriginY() const;
+
+    // the pixel at which column x, or row y, starts
+    double pixelX(qint64 x) const;
+    double pixelY(qint64 y) const;
+
+    // the cell under a pixel
+    qint64 cellX(double x) const;
+    qint64 cellY(double y) const;
+
+    // the cells in the widget, in fractions of a cell
+    QRectF visibleCells() const;
+
+    // moves the picture by (dx, dy) pixels
+    void moveBy(double dx, double dy);
+
+    // multiplies the scale by "factor", keeping the cell under "pixel"
+    // where it is
+    void zoom(double factor, const QPointF &pixel);
+
+    // puts point (x, y), in cells, in the centre of the widget
+    void centerOn(double x, double y);
+
+    // the biggest scale at which the rectangle of cells fits into the
+    // widget, with the rectangle in the centre
+    void fit(qint64 left, qint64 top, qint64 width, qint64 height);
+
+    static const int maxCellWidth = 1024;
+    // a field of 2^30 cells is then 16 pixels wide
+    static const int maxCellsPerPixel = 1 << 26;
+    // the centre is kept this close to the field, so that the distance
+    // to any cell of it fits into 64 bits
+    static const qint64 maxCoordinate = 1LL << 60;
+    static const int subpixelBits = 16;
+};
+
+#endif // VIEWPORT_H